@@ -0,0 +1,217 @@
+#include "tableReader.h"
+#include <cstring>
+#include <limits>
+
+// implementation for ArrowExporter class
+
+using namespace std;
+
+// What an exported ArrowSchema's private_data points to. The schema's strings and children point into it, so it is never
+// copied or moved once the schema has been handed out.
+struct SchemaHolder
+{
+    string format;
+    string name;
+    vector<ArrowSchema> children;
+    vector<ArrowSchema*> childPointers;
+};
+
+// What an exported ArrowArray's private_data points to. Holding the packed column here is what keeps its buffers alive
+// after the reader, or the exporter, has let go of them.
+struct ArrayHolder
+{
+    shared_ptr<PackedColumn> column;
+    const void* buffers[3];
+    vector<ArrowArray> children;
+    vector<ArrowArray*> childPointers;
+};
+
+// The release callbacks. A consumer may move a child out of its parent, and release it later on its own; a moved child
+// has its release set to NULL in the parent, so the parent skips it.
+static void releaseSchema(ArrowSchema* schema)
+{
+    SchemaHolder* holder = (SchemaHolder*)schema->private_data;
+    for (size_t k = 0; k < holder->children.size(); k++)
+    {
+        if (holder->children[k].release != NULL)
+        {
+            holder->children[k].release(&holder->children[k]);
+        }
+    }
+    delete holder;
+    schema->release = NULL;
+}
+
+static void releaseArray(ArrowArray* array)
+{
+    ArrayHolder* holder = (ArrayHolder*)array->private_data;
+    for (size_t k = 0; k < holder->children.size(); k++)
+    {
+        if (holder->children[k].release != NULL)
+        {
+            holder->children[k].release(&holder->children[k]);
+        }
+    }
+    delete holder;
+    array->release = NULL;
+}
+
+// fills in a schema, pointing it at the strings and children in its holder
+static void fillSchema(ArrowSchema* schema, SchemaHolder* holder, int64_t flags)
+{
+    schema->format = holder->format.c_str();
+    schema->name = holder->name.c_str();
+    schema->metadata = NULL;
+    schema->flags = flags;
+    schema->n_children = holder->children.size();
+    schema->children = holder->childPointers.empty() ? NULL : holder->childPointers.data();
+    schema->dictionary = NULL;
+    schema->release = releaseSchema;
+    schema->private_data = holder;
+}
+
+static void fillArray(ArrowArray* array, ArrayHolder* holder, int64_t length, int64_t numBuffers)
+{
+    array->length = length;
+    array->null_count = 0;
+    array->offset = 0;
+    array->n_buffers = numBuffers;
+    array->n_children = holder->children.size();
+    array->buffers = holder->buffers;
+    array->children = holder->childPointers.empty() ? NULL : holder->childPointers.data();
+    array->dictionary = NULL;
+    array->release = releaseArray;
+    array->private_data = holder;
+}
+
+// default constructor
+ArrowExporter::ArrowExporter()
+{
+}
+
+// destructor. Packed columns that have been exported are shared with the arrays, and live on until those are released.
+ArrowExporter::~ArrowExporter()
+{
+}
+
+// The table goes out as a struct array with one child per column, the usual way of passing a record batch through the
+// C Data Interface. Every field is a string, exactly as it was read; no field is null.
+void ArrowExporter::exportColumns(TableReader& reader, const vector<int>& cols, ArrowSchema* outSchema, ArrowArray* outArray)
+{
+    // pack everything before filling anything in, so that a failure leaves nothing half exported
+    vector< shared_ptr<PackedColumn> > columns;
+    for (int k = 0; k < cols.size(); k++)
+    {
+        columns.push_back(packColumn(reader, cols[k]));
+    }
+    vector<string> names = reader.getColNames();
+    int64_t numRows = max(0, reader.getNumRows() - reader.getFirstDataRow());
+
+    SchemaHolder* schemaHolder = new SchemaHolder;
+    schemaHolder->format = "+s";
+    schemaHolder->children.resize(cols.size());
+    ArrayHolder* arrayHolder = new ArrayHolder;
+    arrayHolder->buffers[0] = NULL;
+    arrayHolder->children.resize(cols.size());
+    for (int k = 0; k < cols.size(); k++)
+    {
+        bool large = columns[k]->offsets.empty();
+        SchemaHolder* childSchema = new SchemaHolder;
+        childSchema->format = large ? "U" : "u";
+        childSchema->name = names.empty() ? boost::lexical_cast<string>(cols[k]) : names.at(cols[k]);
+        fillSchema(&schemaHolder->children[k], childSchema, ARROW_FLAG_NULLABLE);
+        schemaHolder->childPointers.push_back(&schemaHolder->children[k]);
+
+        ArrayHolder* childArray = new ArrayHolder;
+        childArray->column = columns[k];
+        childArray->buffers[0] = NULL;
+        childArray->buffers[1] = large ? (const void*)columns[k]->largeOffsets.data() : (const void*)columns[k]->offsets.data();
+        childArray->buffers[2] = columns[k]->data.data();
+        fillArray(&arrayHolder->children[k], childArray, columns[k]->numRows, 3);
+        arrayHolder->childPointers.push_back(&arrayHolder->children[k]);
+    }
+    fillSchema(outSchema, schemaHolder, 0);
+    fillArray(outArray, arrayHolder, numRows, 1);
+}
+
+void ArrowExporter::clear()
+{
+    packed.clear();
+}
+
+int ArrowExporter::getNumPacked()
+{
+    int numPacked = 0;
+    for (int k = 0; k < packed.size(); k++)
+    {
+        if (packed[k])
+        {
+            numPacked++;
+        }
+    }
+    return numPacked;
+}
+
+// here are the protected helper functions
+
+// Copies the data rows of a column into one block, with an offset where each field starts. This is the one pass over the
+// cells that an export costs, since the strings of a column are scattered over the heap and Arrow needs them in one piece.
+shared_ptr<PackedColumn> ArrowExporter::packColumn(TableReader& reader, int col)
+{
+    if (col >= packed.size())
+    {
+        packed.resize(col + 1);
+    }
+    if (packed[col])
+    {
+        return packed[col];
+    }
+    const vector<string>& column = reader.getColumn(col);
+    int firstRow = reader.getFirstDataRow();
+    int numRows = max(0, (int)column.size() - firstRow);
+    shared_ptr<PackedColumn> packedColumn = make_shared<PackedColumn>();
+    packedColumn->numRows = numRows;
+    size_t totalBytes = 0;
+    for (int row = firstRow; row < column.size(); row++)
+    {
+        totalBytes += column[row].size();
+    }
+    // reserving one more byte than needed means the data buffer is never a null pointer, even for a column of empty strings
+    packedColumn->data.reserve(totalBytes + 1);
+    packedColumn->data.resize(totalBytes);
+    char* out = packedColumn->data.data();
+    bool large = (totalBytes > (size_t)numeric_limits<int32_t>::max());
+    if (large)
+    {
+        packedColumn->largeOffsets.resize(numRows + 1);
+    }
+    else
+    {
+        packedColumn->offsets.resize(numRows + 1);
+    }
+    int64_t offset = 0;
+    for (int i = 0; i < numRows; i++)
+    {
+        const string& field = column[firstRow + i];
+        if (large)
+        {
+            packedColumn->largeOffsets[i] = offset;
+        }
+        else
+        {
+            packedColumn->offsets[i] = (int32_t)offset;
+        }
+        memcpy(out + offset, field.data(), field.size());
+        offset += field.size();
+    }
+    if (large)
+    {
+        packedColumn->largeOffsets[numRows] = offset;
+    }
+    else
+    {
+        packedColumn->offsets[numRows] = (int32_t)offset;
+    }
+    packed[col] = packedColumn;
+    return packedColumn;
+}
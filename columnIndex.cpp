@@ -0,0 +1,368 @@
+#include "columnIndex.h"
+#include "tableReader.h"
+#include <cstring>
+#include <fstream>
+
+// implementation for ColumnIndex class
+
+using namespace std;
+
+// how many keys findMany() hashes ahead of probing. Their slots are fetched from memory while the earlier keys are compared.
+static const size_t probeBatch = 16;
+
+// every index file starts with this, followed by an IndexFileHeader. The last character is the version of the format.
+static const char indexMagic[8] = {'T', 'P', 'I', 'N', 'D', 'E', 'X', '2'};
+
+// describes the table an index file was built from. Written in the machine's own byte order, so index files are not portable between machines.
+struct IndexFileHeader
+{
+    char magic[8];
+    int32_t column;
+    int32_t numRows;
+    int32_t firstDataRow;
+    int32_t numKeys;
+    int32_t numDuplicates;
+    uint32_t unused;
+    uint64_t capacity;
+    uint64_t keyFingerprint;
+};
+
+// what is kept of each slot in an index file. The key pointers are only good for the table in memory, so they are filled in again when the file is loaded.
+struct SavedSlot
+{
+    uint32_t hash;
+    int32_t row;
+};
+
+// A fast 64-bit hash, taking the key eight bytes at a time, with the finishing steps of MurmurHash3 so that keys differing in a
+// single character still end up far apart in the table.
+static uint64_t hashKey(const char* data, size_t length)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (length * 0xC6A4A7935BD1E995ULL);
+    while (length >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        word *= 0x87C37B91114253D5ULL;
+        word = (word << 31) | (word >> 33);
+        hash = (hash ^ (word * 0x4CF5AD432745937FULL)) * 5 + 0x52DCE729;
+        data += 8;
+        length -= 8;
+    }
+    // the last few bytes are gathered one at a time. A memcpy of a variable length here is a library call, and costs more than the rest of the hash.
+    uint64_t word = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        word |= (uint64_t)(unsigned char)data[i] << (8 * i);
+    }
+    hash ^= word * 0x87C37B91114253D5ULL;
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// the number of slots build() uses for a column: the smallest power of two, and at least 16, that keeps the table at most 70% full
+static size_t capacityFor(int numDataRows)
+{
+    size_t capacity = 16;
+    while (capacity * 7 < (size_t)numDataRows * 10)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// folds the hash of the next row's key into a fingerprint of the whole column. The order of the rows matters.
+static uint64_t addToFingerprint(uint64_t fingerprint, uint64_t hash)
+{
+    return (fingerprint ^ hash) * 0x100000001B3ULL + 0x9E3779B97F4A7C15ULL;
+}
+
+// default constructor
+ColumnIndex::ColumnIndex() : keys(NULL), column(-1), firstDataRow(0), numRows(0), mask(0), numKeys(0), numDuplicates(0), keyFingerprint(0)
+{
+}
+
+// destructor, included for consistency
+ColumnIndex::~ColumnIndex()
+{
+}
+
+// Linear probing in a table at most 70% full. A slot holds everything needed to compare its key, so a lookup only touches
+// the slots it probes and the characters of the key it finds.
+void ColumnIndex::build(TableReader& reader, int col)
+{
+    attach(reader, col);
+    size_t capacity = capacityFor(numRows - firstDataRow);
+    IndexSlot empty;
+    empty.key = NULL;
+    empty.length = 0;
+    empty.hash = 0;
+    empty.row = -1;
+    slots.assign(capacity, empty);
+    mask = capacity - 1;
+    const vector<string>& column = *keys;
+    for (int row = firstDataRow; row < numRows; row++)
+    {
+        uint64_t hash = hashKey(column[row].data(), column[row].size());
+        keyFingerprint = addToFingerprint(keyFingerprint, hash);
+        uint32_t tag = (uint32_t)(hash >> 32);
+        size_t pos = hash & mask;
+        // stop at an empty slot, or at an earlier row with the same key, which keeps its place
+        while (slots[pos].row >= 0 && ! (slots[pos].hash == tag && column[slots[pos].row] == column[row]))
+        {
+            pos = (pos + 1) & mask;
+        }
+        if (slots[pos].row >= 0)
+        {
+            numDuplicates++;
+            continue;
+        }
+        slots[pos].key = column[row].data();
+        slots[pos].length = column[row].size();
+        slots[pos].hash = tag;
+        slots[pos].row = row;
+        numKeys++;
+    }
+}
+
+void ColumnIndex::build(TableReader& reader, const string& name)
+{
+    build(reader, reader.getColIndex(name));
+}
+
+int ColumnIndex::find(boost::string_ref key)
+{
+    if (slots.empty())
+    {
+        return -1;
+    }
+    return probe(key.data(), key.size(), hashKey(key.data(), key.size()));
+}
+
+void ColumnIndex::findMany(const vector<boost::string_ref>& inKeys, vector<int>& rows)
+{
+    rows.resize(inKeys.size());
+    if (slots.empty())
+    {
+        fill(rows.begin(), rows.end(), -1);
+        return;
+    }
+    uint64_t hashes[probeBatch];
+    for (size_t first = 0; first < inKeys.size(); first += probeBatch)
+    {
+        size_t count = min(probeBatch, inKeys.size() - first);
+        for (size_t k = 0; k < count; k++)
+        {
+            hashes[k] = hashKey(inKeys[first + k].data(), inKeys[first + k].size());
+#ifdef __GNUC__
+            __builtin_prefetch(&slots[hashes[k] & mask]);
+#endif
+        }
+        for (size_t k = 0; k < count; k++)
+        {
+            rows[first + k] = probe(inKeys[first + k].data(), inKeys[first + k].size(), hashes[k]);
+        }
+    }
+}
+
+void ColumnIndex::findMany(const vector<string>& inKeys, vector<int>& rows)
+{
+    vector<boost::string_ref> refs(inKeys.begin(), inKeys.end());
+    findMany(refs, rows);
+}
+
+void ColumnIndex::save(const string& fileName)
+{
+    ofstream indexFile(fileName.c_str(), ios::out | ios::trunc | ios::binary);
+    if (! indexFile.is_open())
+    {
+        throw FileOpenError(fileName);
+    }
+    IndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, indexMagic, sizeof(indexMagic));
+    header.column = column;
+    header.numRows = numRows;
+    header.firstDataRow = firstDataRow;
+    header.numKeys = numKeys;
+    header.numDuplicates = numDuplicates;
+    header.capacity = slots.size();
+    header.keyFingerprint = keyFingerprint;
+    indexFile.write((const char*)&header, sizeof(header));
+    vector<SavedSlot> saved(slots.size());
+    for (size_t pos = 0; pos < slots.size(); pos++)
+    {
+        saved[pos].hash = slots[pos].hash;
+        saved[pos].row = slots[pos].row;
+    }
+    indexFile.write((const char*)saved.data(), saved.size() * sizeof(SavedSlot));
+    indexFile.close();
+    if (indexFile.fail())
+    {
+        throw FileWriteError(fileName);
+    }
+}
+
+// The file is checked against the table before it is trusted: the column, the number of rows, and a fingerprint of every key in
+// the column have to match. A stale index from an older version of the table is turned down, rather than giving wrong rows.
+// Checking the fingerprint hashes every key, but skips the probing and the comparisons that make up most of build().
+bool ColumnIndex::load(const string& fileName, TableReader& reader, int col)
+{
+    clear();
+    ifstream indexFile(fileName.c_str(), ios::in | ios::binary);
+    if (! indexFile.is_open())
+    {
+        throw FileOpenError(fileName);
+    }
+    IndexFileHeader header;
+    indexFile.read((char*)&header, sizeof(header));
+    if (indexFile.gcount() != sizeof(header) || memcmp(header.magic, indexMagic, sizeof(indexMagic) - 1) != 0)
+    {
+        throw FileReadError(fileName);
+    }
+    // a file written in another version of the format is as good as stale
+    if (header.magic[sizeof(indexMagic) - 1] != indexMagic[sizeof(indexMagic) - 1])
+    {
+        return false;
+    }
+    if (header.column != col || header.numRows != reader.getNumRows() || header.firstDataRow != reader.getFirstDataRow())
+    {
+        return false;
+    }
+    // The table has to be the size build() would make it. A table that is too small or too full would make probe() loop forever
+    // on a miss, and a huge capacity would be allocated before anything else was checked.
+    string strColumn = boost::lexical_cast<string>(col);
+    int numDataRows = header.numRows - header.firstDataRow;
+    if (header.capacity != capacityFor(numDataRows))
+    {
+        throw ColumnError(fileName, strColumn, "the capacity is not the one built for this many rows");
+    }
+    if (header.numKeys < 0 || header.numDuplicates < 0 || header.numKeys + header.numDuplicates != numDataRows)
+    {
+        throw ColumnError(fileName, strColumn, "the numbers of keys and duplicates don't add up to the number of rows");
+    }
+    attach(reader, col);
+    const vector<string>& column = *keys;
+    vector<uint32_t> tags(numRows, 0);
+    uint64_t fingerprint = 0;
+    for (int row = firstDataRow; row < numRows; row++)
+    {
+        uint64_t hash = hashKey(column[row].data(), column[row].size());
+        fingerprint = addToFingerprint(fingerprint, hash);
+        tags[row] = (uint32_t)(hash >> 32);
+    }
+    if (fingerprint != header.keyFingerprint)
+    {
+        clear();
+        return false;
+    }
+    vector<SavedSlot> saved(header.capacity);
+    indexFile.read((char*)saved.data(), header.capacity * sizeof(SavedSlot));
+    if ((uint64_t)indexFile.gcount() != header.capacity * sizeof(SavedSlot))
+    {
+        clear();
+        throw FileReadError(fileName);
+    }
+    // the column is the one the file was built from, so a slot that doesn't agree with it means the file is damaged
+    slots.resize(header.capacity);
+    mask = header.capacity - 1;
+    int occupied = 0;
+    for (size_t pos = 0; pos < slots.size(); pos++)
+    {
+        int row = saved[pos].row;
+        slots[pos].hash = saved[pos].hash;
+        slots[pos].row = row;
+        slots[pos].key = NULL;
+        slots[pos].length = 0;
+        if (row < 0)
+        {
+            continue;
+        }
+        if (row < firstDataRow || row >= numRows || saved[pos].hash != tags[row])
+        {
+            clear();
+            throw ColumnError(fileName, strColumn, "a slot doesn't match its row");
+        }
+        occupied++;
+        slots[pos].key = column[row].data();
+        slots[pos].length = column[row].size();
+    }
+    if (occupied != header.numKeys)
+    {
+        clear();
+        throw ColumnError(fileName, strColumn, "the number of keys doesn't match the slots in use");
+    }
+    numKeys = header.numKeys;
+    numDuplicates = header.numDuplicates;
+    keyFingerprint = header.keyFingerprint;
+    return true;
+}
+
+void ColumnIndex::clear()
+{
+    keys = NULL;
+    column = -1;
+    firstDataRow = 0;
+    numRows = 0;
+    slots.clear();
+    mask = 0;
+    numKeys = 0;
+    numDuplicates = 0;
+    keyFingerprint = 0;
+}
+
+int ColumnIndex::getColumn()
+{
+    return column;
+}
+
+int ColumnIndex::getNumKeys()
+{
+    return numKeys;
+}
+
+int ColumnIndex::getNumDuplicates()
+{
+    return numDuplicates;
+}
+
+size_t ColumnIndex::getCapacity()
+{
+    return slots.size();
+}
+
+bool ColumnIndex::isBuilt()
+{
+    return ! slots.empty();
+}
+
+// here are the protected helper functions
+
+void ColumnIndex::attach(TableReader& reader, int col)
+{
+    clear();
+    column = col;
+    firstDataRow = reader.getFirstDataRow();
+    numRows = reader.getNumRows();
+    keys = &reader.getColumn(col);
+}
+
+int ColumnIndex::probe(const char* key, size_t length, uint64_t hash)
+{
+    uint32_t tag = (uint32_t)(hash >> 32);
+    size_t pos = hash & mask;
+    while (slots[pos].row >= 0)
+    {
+        const IndexSlot& slot = slots[pos];
+        if (slot.hash == tag && slot.length == length && memcmp(slot.key, key, length) == 0)
+        {
+            return slot.row;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return -1;
+}
@@ -0,0 +1,60 @@
+// header file for ColumnIndex class
+#ifndef _COLUMN_INDEX_
+#define _COLUMN_INDEX_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+#include "readerExcept.h"
+
+// forward declarations, for sanity
+class TableReader;
+
+// one slot of a ColumnIndex's hash table
+struct IndexSlot
+{
+    const char* key; // the key's characters, inside the reader's own string
+    uint32_t length; // the length of the key
+    uint32_t hash; // the top half of the key's hash, compared before the key itself
+    int32_t row; // the row holding the key, or -1 if the slot is empty
+};
+
+// a hash index on one column of a TableReader, for looking rows up by the value in that column.
+// The keys are not copied: each slot points at the characters of the reader's own string.
+class ColumnIndex
+{
+    public:
+        ColumnIndex();
+        virtual ~ColumnIndex();
+        virtual void build(TableReader& reader, int col); // indexes every data row of the column. The reader must not be reset, reloaded or destroyed while the index is in use.
+        virtual void build(TableReader& reader, const std::string& name); // same as above, for a labelled column
+        virtual int find(boost::string_ref key); // returns the row of the reader's columns holding key, or -1 if there is none. If several rows hold it, returns the first.
+        virtual void findMany(const std::vector<boost::string_ref>& keys, std::vector<int>& rows); // looks up a batch of keys, putting the row for each into rows. Much faster than calling find() in a loop.
+        virtual void findMany(const std::vector<std::string>& keys, std::vector<int>& rows); // same as above
+        virtual void save(const std::string& fileName); // writes the hash table to a file, so that it can be loaded instead of rebuilt. Can throw FileOpenError and FileWriteError.
+        virtual bool load(const std::string& fileName, TableReader& reader, int col); // reads a hash table written by save() for the same column of the same table. Returns false, leaving the index empty, if the file doesn't match the table, down to every key. Can throw FileOpenError and FileReadError, and ColumnError if the file is damaged.
+        virtual void clear(); // empties the index
+        // "get" methods:
+        virtual int getColumn(); // returns the value of column
+        virtual int getNumKeys(); // returns the value of numKeys
+        virtual int getNumDuplicates(); // returns the value of numDuplicates
+        virtual size_t getCapacity(); // returns the number of slots in the hash table
+        virtual bool isBuilt(); // returns whether the index has been built or loaded
+    protected:
+        // helper functions:
+        virtual void attach(TableReader& reader, int col); // points keys at the column in the reader
+        virtual int probe(const char* key, size_t length, uint64_t hash); // finds a key, given its hash
+        // data members
+        const std::vector<std::string>* keys; // the indexed column, in the reader. Good until the reader is reset, reloaded, or makes its columns again.
+        int column; // the index of the indexed column, or -1
+        int firstDataRow; // the first row of the column that holds data, rather than a label
+        int numRows; // the number of rows in the column, including any header row
+        std::vector<IndexSlot> slots; // the hash table. Its size is a power of two, and at most 70% of it is in use.
+        size_t mask; // slots.size() - 1
+        int numKeys; // the number of distinct keys in the index
+        int numDuplicates; // the number of rows whose key was already held by an earlier row
+        uint64_t keyFingerprint; // a hash of every data row's key, in order. Saved with the index, so that load() can tell whether the column has changed since.
+};
+
+#endif
@@ -22,23 +22,13 @@ DelimFinder::~DelimFinder()
 int DelimFinder::guessDelim()
 {
     findPossibleDelims(); // goes through the last row of the raw text data and pulls out all the nonletter, nonnumber characters. Counts the occurrences of each.
-    try
+    // counts up how many times each character found in findPossibleDelims occurs in the rest of the data table
+    if (! countDelimOccurrences())
     {
-        countDelimOccurrences(); // counts up how many times each character found in findPossibleDelims occurs in the rest of the data table
-    }
-    catch (NoDelimsError& nde)
-    {
-        cerr << nde.what() << endl;
+        callingReader.reportWarning("No delimiters found for data in file " + callingReader.getFilename() + ". Data may consist of only one column.");
         return 0; // returning zero indicates zero delimiters
         // note that returning zero without setting the delim leaves it as "NO_DELIMITER"
     }
-    catch (DelimError& de)
-    {
-        cerr << de.what() << endl;
-        // change this to rethrow the exception, so it winds up at the top level
-        // or take it out entirely
-        // actually, in retrospect, you don't want it too far out, because you might really have a table with only one column
-    }
     // Now, the delimList is fully populated with every possible delimiter and how many times it came up in each row
     // If a character comes up twice in the second row and five times in the third, it is not a suitable delimiter. Remove those.
     for (int delimpos = 0; delimpos < delimList.size(); delimpos++)
@@ -77,8 +67,8 @@ int DelimFinder::guessDelim()
     // Count backwards, to avoid indices shifting when you erase stuff.
     for (int q = badInds.size(); q > 0; q--)
     {
-        //cout << "Removing character " << delimList[q].getChara() << " from consideration." << endl;
-        delimList.erase(delimList.begin() + q);
+        //cout << "Removing character " << delimList[badInds[q-1]].getChara() << " from consideration." << endl;
+        delimList.erase(delimList.begin() + badInds[q-1]);
     }
     // delimList now contains all valid, possible delimiter characters.
     // If there is only one valid delim left, end the function and set the delimiter.
@@ -92,8 +82,7 @@ int DelimFinder::guessDelim()
     // If there are no valid delimiters, the data contains only one column.
     if (delimList.size() == 0)
     {
-        cerr << "No valid delimiters found for file " << callingReader.getFilename() << endl;
-        cerr << "The file may contain only one column. If that is not the case, then the data may be incorrectly formatted." << endl;
+        callingReader.reportWarning("No valid delimiters found for file " + callingReader.getFilename() + ". The file may contain only one column. If that is not the case, then the data may be incorrectly formatted.");
         callingReader.numCols = 0;
         return 0;
         // don't actually change the delimiter in the TableReader object. It will stay as "NO_DELIMITER".
@@ -197,8 +186,8 @@ int DelimFinder::guessDelim()
     } // end of if block -- what to do if the max-occurring character is single quotes
     // Commas get priority over periods
     tuple<bool, int> isPers = searchDelims('.');
-    tuple<bool, int> isComs = searhDelims(',');
-    if (get<0>isPers && get<0>isComs)
+    tuple<bool, int> isComs = searchDelims(',');
+    if (get<0>(isPers) && get<0>(isComs))
     {
         callingReader.delim = ",";
         int numDelimsPerRow = delimList[get<1>(isComs)].getOccurrences()[0];
@@ -259,13 +248,13 @@ void DelimFinder::findPossibleDelims()
 
 }
 
-void DelimFinder::countDelimOccurrences()
+bool DelimFinder::countDelimOccurrences()
 {
-    // if there are no possible delimiter characters listed in lastRowCharas, throw an error.
-    //  This will be caught in guessDelim(), but it keeps the rest of the function from carrying on to no purpose.
+    // if there are no possible delimiter characters listed in lastRowCharas, say so.
+    //  guessDelim() checks for this, and it keeps the rest of the function from carrying on to no purpose.
     if (delimList.size() < 1)
     {
-        throw NoDelimsError(callingReader.getFilename());
+        return false;
     }
 
     // establish how many rows of data will be searched for possible delimiters
@@ -308,6 +297,7 @@ void DelimFinder::countDelimOccurrences()
             //else {cout << "no match" << endl;}
         }// end of for loop iterating through the characters in a single row
     } // end of for loop iterating through the rows of data
+    return true;
 }
 
 // a simple binary search algorithm, speeding up sorting through an ordered list.
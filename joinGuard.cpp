@@ -0,0 +1,33 @@
+#include "joinGuard.h"
+
+// implementation for JoinGuard class
+
+using namespace std;
+
+JoinGuard::JoinGuard(vector<thread>& inWorkers) : workers(inWorkers)
+{
+}
+
+JoinGuard::JoinGuard(vector<thread>& inWorkers, function<void ()> inBeforeJoin) : workers(inWorkers), beforeJoin(inBeforeJoin)
+{
+}
+
+JoinGuard::~JoinGuard()
+{
+    if (beforeJoin)
+    {
+        beforeJoin();
+    }
+    joinAll();
+}
+
+void JoinGuard::joinAll()
+{
+    for (size_t w = 0; w < workers.size(); w++)
+    {
+        if (workers[w].joinable())
+        {
+            workers[w].join();
+        }
+    }
+}
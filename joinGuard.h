@@ -0,0 +1,25 @@
+// header file for JoinGuard class
+#ifndef _JOIN_GUARD_
+#define _JOIN_GUARD_
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Joins a set of worker threads however the scope that started them is left. A std::thread destroyed while it can still be
+// joined ends the whole program, so the threads have to be joined even when starting one of them, or the work around them, throws.
+// Declare the guard right after the vector of threads, before the first thread is started.
+class JoinGuard
+{
+    public:
+        JoinGuard(std::vector<std::thread>& inWorkers);
+        JoinGuard(std::vector<std::thread>& inWorkers, std::function<void ()> inBeforeJoin); // inBeforeJoin is called by the destructor before it joins, such as to tell threads waiting for more work to stop
+        virtual ~JoinGuard(); // calls beforeJoin, if there is one, then joins every thread that can still be joined
+        virtual void joinAll(); // joins every thread that can still be joined, for when the threads are known to be finishing
+    protected:
+        // data members
+        std::vector<std::thread>& workers; // the threads, owned by the caller
+        std::function<void ()> beforeJoin; // called by the destructor before joining. Empty if there is nothing to do.
+};
+
+#endif
@@ -65,6 +65,44 @@ const char* FileReadError::what()
     return message.c_str();
 }
 
+// FileWriteError methods. Should be used when writing to an output file fails partway through, such as when the disk fills up.
+
+FileWriteError::FileWriteError(string inFilename) : FileError(inFilename), filename(inFilename)
+{
+    message = "Error while writing to file " + filename + ". The disk may be full, or the file may have been removed while it was open.";
+}
+
+FileWriteError::~FileWriteError()
+    throw()
+{
+    // nothing much here. Just making sure the base class destructor gets overridden.
+}
+
+const char* FileWriteError::what()
+{
+    return message.c_str();
+}
+
+
+// EncodingError methods. Should be used when a data file is not valid UTF-8.
+
+EncodingError::EncodingError(string inFilename, long long inOffset) : FileError(inFilename), filename(inFilename), byteOffset(inOffset)
+{
+    string strOffset = boost::lexical_cast<string>(inOffset);
+    message = "File " + filename + " is not valid UTF-8. The first bad byte is at offset " + strOffset + ".";
+}
+
+EncodingError::~EncodingError()
+    throw()
+{
+    // nothing much here. Just making sure the base class destructor gets overridden.
+}
+
+const char* EncodingError::what()
+{
+    return message.c_str();
+}
+
 
 // DelimError methods. for exceptions thrown by delimFinder objects
 DelimError::DelimError(string inFilename) : filename(inFilename)
@@ -117,3 +155,127 @@ const char* MissingDelimError::what()
 {
     return message.c_str();
 }
+
+// ColumnError methods, thrown when TableReader is asked for a column by a name that isn't in the header row
+ColumnError::ColumnError(string inFilename, string inColumn) : filename(inFilename), column(inColumn)
+{
+    message = "No column named \"" + inColumn + "\" in file " + inFilename + ". The file may not have a header row.";
+}
+
+// for a row index that is past the end of the table, or negative
+ColumnError::ColumnError(string inFilename, int inRow) : filename(inFilename)
+{
+    string strRow = boost::lexical_cast<string>(inRow);
+    message = "No row " + strRow + " in file " + inFilename + ".";
+}
+
+// for a cell past the last column or the last row, or at a negative index
+ColumnError::ColumnError(string inFilename, int inColumn, int inRow) : filename(inFilename)
+{
+    column = boost::lexical_cast<string>(inColumn);
+    string strRow = boost::lexical_cast<string>(inRow);
+    message = "No cell at column " + column + ", row " + strRow + " in file " + inFilename + ".";
+}
+
+// for a file about a column, such as a saved index, whose contents can't be right
+ColumnError::ColumnError(string inFilename, string inColumn, string inProblem) : filename(inFilename), column(inColumn)
+{
+    message = "Bad data for column " + inColumn + " in file " + inFilename + ": " + inProblem + ".";
+}
+
+ColumnError::~ColumnError()
+    throw()
+{
+    // nothing to do here
+}
+
+const char* ColumnError::what()
+{
+    return message.c_str();
+}
+
+LayoutError::LayoutError(string inFilename) : filename(inFilename)
+{
+    message = "The rows of file " + inFilename + " were not indexed as records. Call setRowLayout(true) before makeRawColumns().";
+}
+
+// for a record index past the last row, or negative
+LayoutError::LayoutError(string inFilename, int inRow) : filename(inFilename)
+{
+    string strRow = boost::lexical_cast<string>(inRow);
+    message = "No record " + strRow + " in file " + inFilename + ".";
+}
+
+// for a field past the last column of a record. A RecordView doesn't know its file, so the message gives the row instead.
+LayoutError::LayoutError(int inRow, int inField, int inNumFields)
+{
+    string strRow = boost::lexical_cast<string>(inRow);
+    string strField = boost::lexical_cast<string>(inField);
+    string strNumFields = boost::lexical_cast<string>(inNumFields);
+    message = "No field " + strField + " in record " + strRow + ", which has " + strNumFields + " fields.";
+}
+
+LayoutError::~LayoutError()
+    throw()
+{
+    // nothing to do here
+}
+
+const char* LayoutError::what()
+{
+    return message.c_str();
+}
+
+SettingsError::SettingsError(string inFilename, string inProblem) : filename(inFilename)
+{
+    message = "Can't make columns from file " + inFilename + ": " + inProblem + ".";
+}
+
+SettingsError::~SettingsError()
+    throw()
+{
+    // nothing to do here
+}
+
+const char* SettingsError::what()
+{
+    return message.c_str();
+}
+
+PatternError::PatternError(string inPattern) : pattern(inPattern)
+{
+    message = "The filename pattern \"" + inPattern + "\" is not a valid regular expression.";
+}
+
+// for a pattern read from a profile file
+PatternError::PatternError(string inPattern, string inFilename) : pattern(inPattern)
+{
+    message = "The filename pattern \"" + inPattern + "\" in profile file " + inFilename + " is not a valid regular expression.";
+}
+
+PatternError::~PatternError()
+    throw()
+{
+    // nothing to do here
+}
+
+const char* PatternError::what()
+{
+    return message.c_str();
+}
+
+QueryError::QueryError(string inFilename, string inProblem) : filename(inFilename)
+{
+    message = "Can't query file " + inFilename + ": " + inProblem + ".";
+}
+
+QueryError::~QueryError()
+    throw()
+{
+    // nothing to do here
+}
+
+const char* QueryError::what()
+{
+    return message.c_str();
+}
@@ -8,7 +8,7 @@
 
 using namespace std;
 
-// FileError and its children FileOpenError and FileReadError
+// FileError and its children FileOpenError, FileReadError, FileWriteError and EncodingError
 
 class FileError : public exception
 {
@@ -47,6 +47,31 @@ class FileReadError : public FileError
 
 };
 
+class FileWriteError : public FileError
+{
+    public:
+        FileWriteError(string inFilename);
+        virtual ~FileWriteError()
+            throw();
+        virtual const char* what();
+    private:
+        string filename;
+        string message;
+};
+
+class EncodingError : public FileError
+{
+    public:
+        EncodingError(string inFilename, long long inOffset);
+        virtual ~EncodingError()
+            throw();
+        virtual const char* what();
+    private:
+        string filename;
+        long long byteOffset;
+        string message;
+};
+
 // DelimError and its children NoDelimsError and MissingDelimError
 
 class DelimError : public exception
@@ -86,5 +111,83 @@ class MissingDelimError : public DelimError
         string message;
 };
 
+// ColumnError, thrown when a column is looked up by a name the table doesn't have, or a row by an index it doesn't have, or when
+// the saved index of a column is damaged
+
+class ColumnError : public exception
+{
+    public:
+        ColumnError(string inFilename, string inColumn);
+        ColumnError(string inFilename, int inRow);
+        ColumnError(string inFilename, int inColumn, int inRow);
+        ColumnError(string inFilename, string inColumn, string inProblem);
+        virtual ~ColumnError()
+            throw();
+        virtual const char* what();
+    private:
+        string filename;
+        string column;
+        string message;
+};
+
+// LayoutError, thrown when rows are asked for as records, but the table was not made in row layout mode, or when a record or
+// a field of one is asked for that isn't there
+
+class LayoutError : public exception
+{
+    public:
+        LayoutError(string inFilename);
+        LayoutError(string inFilename, int inRow);
+        LayoutError(int inRow, int inField, int inNumFields);
+        virtual ~LayoutError()
+            throw();
+        virtual const char* what();
+    private:
+        string filename;
+        string message;
+};
+
+// SettingsError, thrown when a TableReader is asked to use settings that can't work together
+
+class SettingsError : public exception
+{
+    public:
+        SettingsError(string inFilename, string inProblem);
+        virtual ~SettingsError()
+            throw();
+        virtual const char* what();
+    private:
+        string filename;
+        string message;
+};
+
+// PatternError, thrown when a schema profile is given a filename pattern that isn't a valid regular expression
+
+class PatternError : public exception
+{
+    public:
+        PatternError(string inPattern);
+        PatternError(string inPattern, string inFilename);
+        virtual ~PatternError()
+            throw();
+        virtual const char* what();
+    private:
+        string pattern;
+        string message;
+};
+
+// QueryError, thrown when a TableQuery is asked for something that can't be computed
+
+class QueryError : public exception
+{
+    public:
+        QueryError(string inFilename, string inProblem);
+        virtual ~QueryError()
+            throw();
+        virtual const char* what();
+    private:
+        string filename;
+        string message;
+};
 
 #endif
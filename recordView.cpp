@@ -0,0 +1,98 @@
+#include "tableReader.h"
+
+// implementation for RecordView and RecordIterator classes
+
+using namespace std;
+
+// an empty view, with no fields
+RecordView::RecordView() : data(NULL), length(0), starts(NULL), numFields(0), delimLength(0), row(-1)
+{
+}
+
+RecordView::RecordView(const char* inData, size_t inLength, const uint32_t* inStarts, int inNumFields, size_t inDelimLength, int inRow) : data(inData), length(inLength),
+    starts(inStarts), numFields(inNumFields), delimLength(inDelimLength), row(inRow)
+{
+}
+
+string RecordView::getFieldString(int field) const
+{
+    return getField(field).to_string();
+}
+
+int RecordView::getNumFields() const
+{
+    return numFields;
+}
+
+int RecordView::getRow() const
+{
+    return row;
+}
+
+boost::string_ref RecordView::getText() const
+{
+    return boost::string_ref(data, length);
+}
+
+void RecordView::throwFieldError(int field) const
+{
+    throw LayoutError(row, field, numFields);
+}
+
+// an iterator that belongs to no reader. Only good for assigning to.
+RecordIterator::RecordIterator() : reader(NULL), row(0), viewRow(-1)
+{
+}
+
+RecordIterator::RecordIterator(TableReader* inReader, int inRow) : reader(inReader), row(inRow), viewRow(-1)
+{
+}
+
+// destructor, included for consistency
+RecordIterator::~RecordIterator()
+{
+}
+
+// The row is only looked up once, however many of its fields are read through the iterator.
+const RecordView& RecordIterator::operator*()
+{
+    if (viewRow != row)
+    {
+        view = reader->getRecord(row);
+        viewRow = row;
+    }
+    return view;
+}
+
+const RecordView* RecordIterator::operator->()
+{
+    return &(**this);
+}
+
+RecordIterator& RecordIterator::operator++()
+{
+    row++;
+    return *this;
+}
+
+RecordIterator RecordIterator::operator++(int)
+{
+    RecordIterator before(*this);
+    row++;
+    return before;
+}
+
+bool RecordIterator::operator==(const RecordIterator& other) const
+{
+    return reader == other.reader && row == other.row;
+}
+
+bool RecordIterator::operator!=(const RecordIterator& other) const
+{
+    return ! (*this == other);
+}
+
+int RecordIterator::getRow() const
+{
+    return row;
+}
@@ -0,0 +1,277 @@
+#include "tableReader.h"
+
+// implementation for SchemaProfile class
+
+using namespace std;
+
+// the first line of every profile file
+static const string profileMagic = "TableParser schema profile 1";
+
+// the names colTypes are written out as, in ColumnType order
+static const char* typeNames[] = {"empty", "integer", "real", "text"};
+
+// Delimiters and header rows can hold tabs, and the odd backslash, so they are escaped to keep each value on one line.
+static string escapeValue(const string& value)
+{
+    string escaped;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        switch (value[i])
+        {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            default:
+                escaped += value[i];
+                break;
+        }
+    }
+    return escaped;
+}
+
+static string unescapeValue(const string& value)
+{
+    string unescaped;
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        if (value[i] != '\\' || i + 1 == value.size())
+        {
+            unescaped += value[i];
+            continue;
+        }
+        i++;
+        switch (value[i])
+        {
+            case 't':
+                unescaped += '\t';
+                break;
+            case 'n':
+                unescaped += '\n';
+                break;
+            case 'r':
+                unescaped += '\r';
+                break;
+            default:
+                unescaped += value[i];
+                break;
+        }
+    }
+    return unescaped;
+}
+
+// Compiles a filename pattern as soon as it is given, so that a bad one is reported there, as a PatternError quoting it, rather
+// than as a regex_error out of makeRawColumns(). fileName is the profile file the pattern was read from, or empty.
+static boost::regex compilePattern(const string& pattern, const string& fileName)
+{
+    try
+    {
+        return boost::regex(pattern);
+    }
+    catch (boost::regex_error&)
+    {
+        if (fileName.empty())
+        {
+            throw PatternError(pattern);
+        }
+        throw PatternError(pattern, fileName);
+    }
+}
+
+// default constructor, makes an empty profile
+SchemaProfile::SchemaProfile() : numCols(0), hasHeader(false)
+{
+}
+
+// destructor, included for consistency
+SchemaProfile::~SchemaProfile()
+{
+}
+
+// One "key=value" line per setting, so that profiles can be read, and fixed, by hand.
+void SchemaProfile::save(const string& fileName)
+{
+    ofstream profileFile(fileName.c_str(), ios::out | ios::trunc);
+    if (! profileFile.is_open())
+    {
+        throw FileOpenError(fileName);
+    }
+    profileFile << profileMagic << "\n";
+    profileFile << "name=" << escapeValue(name) << "\n";
+    profileFile << "pattern=" << escapeValue(filenamePattern) << "\n";
+    profileFile << "delimiter=" << escapeValue(delim) << "\n";
+    profileFile << "columns=" << numCols << "\n";
+    profileFile << "header=" << (hasHeader ? 1 : 0) << "\n";
+    profileFile << "headerline=" << escapeValue(headerLine) << "\n";
+    profileFile << "types=";
+    for (int k = 0; k < colTypes.size(); k++)
+    {
+        profileFile << ((k > 0) ? "," : "") << typeNames[colTypes[k]];
+    }
+    profileFile << "\n";
+    profileFile.close();
+    if (profileFile.fail())
+    {
+        throw FileWriteError(fileName);
+    }
+}
+
+// Unknown keys are skipped, so that later versions can add settings. A profile that doesn't hang together is a read error.
+void SchemaProfile::load(const string& fileName)
+{
+    ifstream profileFile(fileName.c_str());
+    if (! profileFile.is_open())
+    {
+        throw FileOpenError(fileName);
+    }
+    string line;
+    if (! getline(profileFile, line) || line != profileMagic)
+    {
+        throw FileReadError(fileName);
+    }
+    SchemaProfile loaded;
+    while (getline(profileFile, line))
+    {
+        size_t equals = line.find('=');
+        if (equals == string::npos)
+        {
+            continue;
+        }
+        string key = line.substr(0, equals);
+        string value = unescapeValue(line.substr(equals + 1));
+        try
+        {
+            if (key == "name")
+            {
+                loaded.name = value;
+            }
+            else if (key == "pattern")
+            {
+                loaded.filenamePattern = value;
+                loaded.filenameRegex = compilePattern(value, fileName);
+            }
+            else if (key == "delimiter")
+            {
+                loaded.delim = value;
+            }
+            else if (key == "columns")
+            {
+                loaded.numCols = boost::lexical_cast<int>(value);
+            }
+            else if (key == "header")
+            {
+                loaded.hasHeader = (value == "1");
+            }
+            else if (key == "headerline")
+            {
+                loaded.headerLine = value;
+            }
+            else if (key == "types")
+            {
+                size_t start = 0;
+                while (start <= value.size() && ! value.empty())
+                {
+                    size_t comma = value.find(',', start);
+                    string typeName = value.substr(start, (comma == string::npos) ? string::npos : comma - start);
+                    int type = 0;
+                    while (type < 4 && typeName != typeNames[type])
+                    {
+                        type++;
+                    }
+                    if (type == 4)
+                    {
+                        throw FileReadError(fileName);
+                    }
+                    loaded.colTypes.push_back((ColumnType)type);
+                    if (comma == string::npos)
+                    {
+                        break;
+                    }
+                    start = comma + 1;
+                }
+            }
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+            throw FileReadError(fileName);
+        }
+    }
+    if (loaded.numCols < 1 || loaded.delim.empty() || loaded.colTypes.size() != loaded.numCols)
+    {
+        throw FileReadError(fileName);
+    }
+    *this = loaded;
+}
+
+void SchemaProfile::setName(const string& inName)
+{
+    name = inName;
+}
+
+void SchemaProfile::setFilenamePattern(const string& inPattern)
+{
+    filenameRegex = compilePattern(inPattern, string());
+    filenamePattern = inPattern;
+}
+
+bool SchemaProfile::matchesFilename(const string& fileName)
+{
+    if (filenamePattern.empty())
+    {
+        return false;
+    }
+    return boost::regex_search(fileName, filenameRegex);
+}
+
+bool SchemaProfile::matchesHeader(const string& firstRow)
+{
+    return hasHeader && firstRow == headerLine;
+}
+
+string SchemaProfile::getName()
+{
+    return name;
+}
+
+string SchemaProfile::getFilenamePattern()
+{
+    return filenamePattern;
+}
+
+string SchemaProfile::getDelim()
+{
+    return delim;
+}
+
+int SchemaProfile::getNumCols()
+{
+    return numCols;
+}
+
+bool SchemaProfile::hasHeaderRow()
+{
+    return hasHeader;
+}
+
+string SchemaProfile::getHeaderLine()
+{
+    return headerLine;
+}
+
+vector<ColumnType> SchemaProfile::getColTypes()
+{
+    return colTypes;
+}
+
+bool SchemaProfile::isEmpty()
+{
+    return numCols == 0;
+}
@@ -0,0 +1,154 @@
+#include "tableReader.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+// implementation for the SpillFile class.
+using namespace std;
+
+// Each segment is laid out as (numItems + 1) 64-bit offsets, followed by the bytes of every item back to back.
+// Item i runs from offset i to offset i+1, counted from the end of the offsets.
+
+// constructor. Creates the temporary file and deletes its name right away, so nothing is left behind.
+SpillFile::SpillFile(const string& inDirectory) : fileDesc(-1), fileSize(0), mappedOffset(-1), mappedBase(NULL), mappedLength(0)
+{
+    path = inDirectory + "/tableReaderSpillXXXXXX";
+    vector<char> pathChars(path.begin(), path.end());
+    pathChars.push_back('\0');
+    fileDesc = mkstemp(&pathChars[0]);
+    if (fileDesc < 0)
+    {
+        throw FileOpenError(path);
+    }
+    path = &pathChars[0];
+    unlink(path.c_str());
+}
+
+// destructor
+SpillFile::~SpillFile()
+{
+    if (mappedBase != NULL)
+    {
+        munmap(mappedBase, mappedLength);
+    }
+    if (fileDesc >= 0)
+    {
+        close(fileDesc);
+    }
+}
+
+SpillSegment SpillFile::writeSegment(const vector<string>& items)
+{
+    // start every segment on a page boundary, so it can be mapped by itself
+    long long pageSize = sysconf(_SC_PAGESIZE);
+    fileSize = ((fileSize + pageSize - 1) / pageSize) * pageSize;
+    SpillSegment segment;
+    segment.fileOffset = fileSize;
+    segment.numItems = items.size();
+    uint64_t itemOffset = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        writeBytes((const char*)&itemOffset, sizeof(itemOffset));
+        itemOffset += items[i].size();
+    }
+    writeBytes((const char*)&itemOffset, sizeof(itemOffset));
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        writeBytes(items[i].data(), items[i].size());
+    }
+    flushWriteBuffer();
+    segment.length = fileSize - segment.fileOffset;
+    return segment;
+}
+
+boost::string_ref SpillFile::getItem(const SpillSegment& segment, size_t index)
+{
+    const char* base = mapSegment(segment);
+    const uint64_t* offsets = (const uint64_t*)base;
+    const char* data = base + (segment.numItems + 1) * sizeof(uint64_t);
+    return boost::string_ref(data + offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+void SpillFile::readSegment(const SpillSegment& segment, vector<string>& out)
+{
+    const char* base = mapSegment(segment);
+    const uint64_t* offsets = (const uint64_t*)base;
+    const char* data = base + (segment.numItems + 1) * sizeof(uint64_t);
+    out.reserve(out.size() + segment.numItems);
+    for (size_t i = 0; i < segment.numItems; i++)
+    {
+        out.push_back(string(data + offsets[i], offsets[i + 1] - offsets[i]));
+    }
+}
+
+long long SpillFile::getSize()
+{
+    return fileSize;
+}
+
+// PROTECTED METHODS. Only used for helping other methods.
+
+// Only one segment is mapped at a time. The mapped pages are clean file pages, which the system can drop whenever it needs the memory,
+// but keeping a single mapping means they don't pile up in the resident set of the process either.
+const char* SpillFile::mapSegment(const SpillSegment& segment)
+{
+    if (mappedOffset == segment.fileOffset && mappedBase != NULL)
+    {
+        return mappedBase;
+    }
+    if (mappedBase != NULL)
+    {
+        munmap(mappedBase, mappedLength);
+        mappedBase = NULL;
+        mappedOffset = -1;
+    }
+    void* mapping = mmap(NULL, segment.length, PROT_READ, MAP_SHARED, fileDesc, segment.fileOffset);
+    if (mapping == MAP_FAILED)
+    {
+        throw FileReadError(path);
+    }
+    madvise(mapping, segment.length, MADV_SEQUENTIAL);
+    mappedBase = (char*)mapping;
+    mappedLength = segment.length;
+    mappedOffset = segment.fileOffset;
+    return mappedBase;
+}
+
+void SpillFile::writeBytes(const char* data, size_t length)
+{
+    const size_t writeBufferSize = 1 << 20;
+    if (writeBuffer.size() + length > writeBufferSize)
+    {
+        flushWriteBuffer();
+    }
+    if (length > writeBufferSize)
+    {
+        // too big to be worth buffering. Write it straight through.
+        writeBuffer.assign(data, length);
+        flushWriteBuffer();
+        return;
+    }
+    writeBuffer.append(data, length);
+}
+
+void SpillFile::flushWriteBuffer()
+{
+    size_t written = 0;
+    while (written < writeBuffer.size())
+    {
+        ssize_t result = pwrite(fileDesc, writeBuffer.data() + written, writeBuffer.size() - written, fileSize + written);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            throw FileWriteError(path);
+        }
+        written += result;
+    }
+    fileSize += written;
+    writeBuffer.clear();
+}
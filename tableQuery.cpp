@@ -0,0 +1,636 @@
+#include "tableQuery.h"
+#include "tableReader.h"
+#include "joinGuard.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+
+// implementation for TableQuery class
+
+using namespace std;
+
+// below this many rows per thread, starting threads costs more than it saves
+static const int minRowsPerThread = 65536;
+
+static const double notANumber = numeric_limits<double>::quiet_NaN();
+
+// Whether [pos, end) is a plain decimal number with no sign: digits with an optional decimal point, at least one digit, and an
+// optional exponent. strtod() also takes hex ("0x1F"), "inf" and "nan", which aren't numbers in a table, so it only sees what
+// passes this.
+static bool isDecimal(const char* pos, const char* end)
+{
+    bool hasDigit = false;
+    while (pos < end && *pos >= '0' && *pos <= '9')
+    {
+        hasDigit = true;
+        pos++;
+    }
+    if (pos < end && *pos == '.')
+    {
+        pos++;
+        while (pos < end && *pos >= '0' && *pos <= '9')
+        {
+            hasDigit = true;
+            pos++;
+        }
+    }
+    if (! hasDigit)
+    {
+        return false;
+    }
+    if (pos < end && (*pos == 'e' || *pos == 'E'))
+    {
+        pos++;
+        if (pos < end && (*pos == '+' || *pos == '-'))
+        {
+            pos++;
+        }
+        if (pos == end || *pos < '0' || *pos > '9')
+        {
+            return false;
+        }
+        while (pos < end && *pos >= '0' && *pos <= '9')
+        {
+            pos++;
+        }
+    }
+    return pos == end;
+}
+
+// Converts one field to a number, ignoring leading and trailing whitespace. Returns NaN if the field is empty or isn't a number.
+// Whole numbers of up to 18 digits, which are most fields in most tables, are converted by hand; everything else goes through strtod.
+static double parseNumber(const string& cell)
+{
+    const char* pos = cell.c_str();
+    const char* end = pos + cell.size();
+    while (pos < end && isspace((unsigned char)*pos))
+    {
+        pos++;
+    }
+    while (end > pos && isspace((unsigned char)end[-1]))
+    {
+        end--;
+    }
+    if (pos == end)
+    {
+        return notANumber;
+    }
+    const char* digits = pos;
+    bool negative = false;
+    if (*digits == '+' || *digits == '-')
+    {
+        negative = (*digits == '-');
+        digits++;
+    }
+    long long whole = 0;
+    const char* scan = digits;
+    while (scan < end && scan - digits < 18 && *scan >= '0' && *scan <= '9')
+    {
+        whole = whole * 10 + (*scan - '0');
+        scan++;
+    }
+    if (scan == end && scan > digits)
+    {
+        return negative ? -(double)whole : (double)whole;
+    }
+    // strtod also takes things like "inf" and "0x1F", which are not numbers in a data table
+    if (! isDecimal(digits, end))
+    {
+        return notANumber;
+    }
+    char* parsedEnd;
+    double value = strtod(pos, &parsedEnd);
+    return (parsedEnd == end) ? value : notANumber;
+}
+
+// constructor. The reader should already have made its columns.
+TableQuery::TableQuery(TableReader& inReader) : reader(inReader), numThreads(1), firstDataRow(0), numDataRows(0), filtered(false)
+{
+    clearCache();
+}
+
+// destructor, included for consistency
+TableQuery::~TableQuery()
+{
+}
+
+void TableQuery::setNumThreads(int inThreads)
+{
+    numThreads = (inThreads > 0) ? inThreads : 1;
+}
+
+// Each comparison is a separate loop with no branches in it, so the compiler can turn it into vector instructions.
+// NaN compares false against everything, which drops rows without a number; CMP_NOT_EQUAL has to drop them explicitly.
+void TableQuery::where(int col, CompareOp op, double value)
+{
+    const vector<double>& numbers = getNumbers(col);
+    startSelection();
+    const double* v = numbers.data();
+    char* sel = selection.data();
+    int n = numDataRows;
+    switch (op)
+    {
+        case CMP_EQUAL:
+            for (int i = 0; i < n; i++)
+            {
+                sel[i] &= (v[i] == value);
+            }
+            break;
+        case CMP_NOT_EQUAL:
+            for (int i = 0; i < n; i++)
+            {
+                sel[i] &= ((v[i] != value) & (v[i] == v[i]));
+            }
+            break;
+        case CMP_LESS:
+            for (int i = 0; i < n; i++)
+            {
+                sel[i] &= (v[i] < value);
+            }
+            break;
+        case CMP_LESS_EQUAL:
+            for (int i = 0; i < n; i++)
+            {
+                sel[i] &= (v[i] <= value);
+            }
+            break;
+        case CMP_GREATER:
+            for (int i = 0; i < n; i++)
+            {
+                sel[i] &= (v[i] > value);
+            }
+            break;
+        case CMP_GREATER_EQUAL:
+            for (int i = 0; i < n; i++)
+            {
+                sel[i] &= (v[i] >= value);
+            }
+            break;
+    }
+}
+
+void TableQuery::where(const string& name, CompareOp op, double value)
+{
+    where(reader.getColIndex(name), op, value);
+}
+
+// the value is looked up in the column's dictionary once, and then only the codes are compared
+void TableQuery::whereEquals(int col, const string& value)
+{
+    const EncodedColumn& encoded = getEncoded(col);
+    startSelection();
+    unordered_map<string, int>::const_iterator found = encoded.lookup.find(value);
+    int code = (found == encoded.lookup.end()) ? -1 : found->second;
+    const int* codes = encoded.codes.data();
+    char* sel = selection.data();
+    for (int i = 0; i < numDataRows; i++)
+    {
+        sel[i] &= (codes[i] == code);
+    }
+}
+
+void TableQuery::whereEquals(const string& name, const string& value)
+{
+    whereEquals(reader.getColIndex(name), value);
+}
+
+void TableQuery::groupBy(int col)
+{
+    getEncoded(col);
+    groupColumns.push_back(col);
+}
+
+void TableQuery::groupBy(const string& name)
+{
+    groupBy(reader.getColIndex(name));
+}
+
+// Only a count makes sense without a column. Anything else over column -1 would just be the size of each group again.
+void TableQuery::addAggregate(AggregateOp op, int col)
+{
+    if (col < 0 && op != AGG_COUNT)
+    {
+        throw QueryError(reader.getFilename(), "only AGG_COUNT can be computed without a column");
+    }
+    if (col >= 0)
+    {
+        getNumbers(col);
+    }
+    Aggregate aggregate;
+    aggregate.op = op;
+    aggregate.column = col;
+    aggregates.push_back(aggregate);
+}
+
+void TableQuery::addAggregate(AggregateOp op, const string& name)
+{
+    addAggregate(op, reader.getColIndex(name));
+}
+
+// Each column that an aggregate needs is passed over once, however many aggregates use it. With several threads, each one
+// aggregates its own share of the rows into its own partial results, which are merged once they are all done.
+QueryResult TableQuery::run()
+{
+    QueryResult result;
+    vector<int> groupIds;
+    vector< vector<int> > groupCodes;
+    int numGroups = 1;
+    if (! groupColumns.empty())
+    {
+        assignGroups(groupIds, groupCodes);
+        numGroups = groupCodes.size();
+    }
+    vector<long long> groupSizes(numGroups, 0);
+    for (int i = 0; i < numDataRows; i++)
+    {
+        if (! filtered || selection[i])
+        {
+            groupSizes[groupIds.empty() ? 0 : groupIds[i]]++;
+        }
+    }
+
+    // the distinct columns the aggregates need, and where each one's state is
+    vector<int> stateColumns;
+    vector<int> stateIndex(aggregates.size(), -1);
+    for (int a = 0; a < aggregates.size(); a++)
+    {
+        if (aggregates[a].column < 0)
+        {
+            continue;
+        }
+        for (int s = 0; s < stateColumns.size() && stateIndex[a] < 0; s++)
+        {
+            if (stateColumns[s] == aggregates[a].column)
+            {
+                stateIndex[a] = s;
+            }
+        }
+        if (stateIndex[a] < 0)
+        {
+            stateIndex[a] = stateColumns.size();
+            stateColumns.push_back(aggregates[a].column);
+        }
+    }
+
+    int usedThreads = numThreads;
+    if (usedThreads > 1 && numDataRows / usedThreads < minRowsPerThread)
+    {
+        usedThreads = max(1, numDataRows / minRowsPerThread);
+    }
+    vector<AggregateState> states(stateColumns.size());
+    for (int s = 0; s < stateColumns.size(); s++)
+    {
+        const vector<double>& values = getNumbers(stateColumns[s]);
+        vector<AggregateState> partials(usedThreads);
+        for (int t = 0; t < usedThreads; t++)
+        {
+            partials[t].sums.assign(numGroups, 0.0);
+            partials[t].counts.assign(numGroups, 0);
+            partials[t].mins.assign(numGroups, numeric_limits<double>::infinity());
+            partials[t].maxes.assign(numGroups, -numeric_limits<double>::infinity());
+        }
+        if (usedThreads == 1)
+        {
+            aggregateRows(values, groupIds, 0, numDataRows, partials[0]);
+        }
+        else
+        {
+            vector<thread> workers;
+            JoinGuard guard(workers);
+            for (int t = 0; t < usedThreads; t++)
+            {
+                int first = (int)((long long)numDataRows * t / usedThreads);
+                int last = (int)((long long)numDataRows * (t + 1) / usedThreads);
+                workers.push_back(thread(&TableQuery::aggregateRows, this, cref(values), cref(groupIds), first, last, ref(partials[t])));
+            }
+            guard.joinAll();
+        }
+        states[s] = move(partials[0]);
+        for (int t = 1; t < usedThreads; t++)
+        {
+            for (int g = 0; g < numGroups; g++)
+            {
+                states[s].sums[g] += partials[t].sums[g];
+                states[s].counts[g] += partials[t].counts[g];
+                states[s].mins[g] = min(states[s].mins[g], partials[t].mins[g]);
+                states[s].maxes[g] = max(states[s].maxes[g], partials[t].maxes[g]);
+            }
+        }
+    }
+
+    // with grouping, groups that no selected row falls into are left out
+    vector<int> keptGroups;
+    for (int g = 0; g < numGroups; g++)
+    {
+        if (groupColumns.empty() || groupSizes[g] > 0)
+        {
+            keptGroups.push_back(g);
+        }
+    }
+    for (int k = 0; k < groupColumns.size(); k++)
+    {
+        const EncodedColumn& encoded = getEncoded(groupColumns[k]);
+        result.labels.push_back(columnLabel(groupColumns[k]));
+        result.keys.push_back(vector<string>());
+        result.keys[k].reserve(keptGroups.size());
+        for (int g = 0; g < keptGroups.size(); g++)
+        {
+            result.keys[k].push_back(encoded.dictionary[groupCodes[keptGroups[g]][k]]);
+        }
+    }
+    const char* opNames[] = {"count", "sum", "min", "max", "mean"};
+    for (int a = 0; a < aggregates.size(); a++)
+    {
+        const Aggregate& aggregate = aggregates[a];
+        result.labels.push_back(string(opNames[aggregate.op]) + "(" + ((aggregate.column < 0) ? string("*") : columnLabel(aggregate.column)) + ")");
+        result.values.push_back(vector<double>());
+        vector<double>& out = result.values[a];
+        out.reserve(keptGroups.size());
+        for (int g = 0; g < keptGroups.size(); g++)
+        {
+            int group = keptGroups[g];
+            if (aggregate.column < 0)
+            {
+                out.push_back((double)groupSizes[group]);
+                continue;
+            }
+            const AggregateState& state = states[stateIndex[a]];
+            long long count = state.counts[group];
+            switch (aggregate.op)
+            {
+                case AGG_COUNT:
+                    out.push_back((double)count);
+                    break;
+                case AGG_SUM:
+                    out.push_back(state.sums[group]);
+                    break;
+                case AGG_MIN:
+                    out.push_back((count > 0) ? state.mins[group] : notANumber);
+                    break;
+                case AGG_MAX:
+                    out.push_back((count > 0) ? state.maxes[group] : notANumber);
+                    break;
+                case AGG_MEAN:
+                    out.push_back((count > 0) ? state.sums[group] / count : notANumber);
+                    break;
+            }
+        }
+    }
+    for (int g = 0; g < keptGroups.size(); g++)
+    {
+        result.groupSizes.push_back(groupSizes[keptGroups[g]]);
+    }
+    return result;
+}
+
+void TableQuery::clearQuery()
+{
+    selection.clear();
+    filtered = false;
+    groupColumns.clear();
+    aggregates.clear();
+}
+
+void TableQuery::clearCache()
+{
+    clearQuery();
+    numberColumns.clear();
+    encodedColumns.clear();
+    firstDataRow = reader.getFirstDataRow();
+    numDataRows = max(0, reader.getNumRows() - firstDataRow);
+}
+
+// Converts the whole column the first time it is asked for. The reader's column is fetched once, and then split between
+// the threads, which only read it.
+const vector<double>& TableQuery::getNumbers(int col)
+{
+    unordered_map<int, vector<double> >::iterator found = numberColumns.find(col);
+    if (found != numberColumns.end())
+    {
+        return found->second;
+    }
+    const vector<string>& column = reader.getColumn(col);
+    vector<double>& out = numberColumns[col];
+    out.resize(numDataRows);
+    int usedThreads = numThreads;
+    if (usedThreads > 1 && numDataRows / usedThreads < minRowsPerThread)
+    {
+        usedThreads = max(1, numDataRows / minRowsPerThread);
+    }
+    if (usedThreads == 1)
+    {
+        convertRows(column, firstDataRow, firstDataRow + numDataRows, out);
+    }
+    else
+    {
+        vector<thread> workers;
+        JoinGuard guard(workers);
+        for (int t = 0; t < usedThreads; t++)
+        {
+            int first = firstDataRow + (int)((long long)numDataRows * t / usedThreads);
+            int last = firstDataRow + (int)((long long)numDataRows * (t + 1) / usedThreads);
+            workers.push_back(thread(&TableQuery::convertRows, this, cref(column), first, last, ref(out)));
+        }
+        guard.joinAll();
+    }
+    return out;
+}
+
+const EncodedColumn& TableQuery::getEncoded(int col)
+{
+    unordered_map<int, EncodedColumn>::iterator found = encodedColumns.find(col);
+    if (found != encodedColumns.end())
+    {
+        return found->second;
+    }
+    const vector<string>& column = reader.getColumn(col);
+    EncodedColumn& encoded = encodedColumns[col];
+    encoded.codes.resize(numDataRows);
+    for (int i = 0; i < numDataRows; i++)
+    {
+        const string& value = column[firstDataRow + i];
+        pair<unordered_map<string, int>::iterator, bool> inserted = encoded.lookup.insert(make_pair(value, (int)encoded.dictionary.size()));
+        if (inserted.second)
+        {
+            encoded.dictionary.push_back(value);
+        }
+        encoded.codes[i] = inserted.first->second;
+    }
+    return encoded;
+}
+
+const vector<char>& TableQuery::getSelection()
+{
+    startSelection();
+    return selection;
+}
+
+long TableQuery::getNumSelected()
+{
+    if (! filtered)
+    {
+        return numDataRows;
+    }
+    long numSelected = 0;
+    for (int i = 0; i < numDataRows; i++)
+    {
+        numSelected += selection[i];
+    }
+    return numSelected;
+}
+
+int TableQuery::getNumDataRows()
+{
+    return numDataRows;
+}
+
+int TableQuery::getNumThreads()
+{
+    return numThreads;
+}
+
+// numbers are written with 15 significant digits, and NaN as an empty field
+vector< vector<string> > TableQuery::formatResult(const QueryResult& result)
+{
+    vector< vector<string> > columns(result.labels.size());
+    for (int k = 0; k < columns.size(); k++)
+    {
+        columns[k].push_back(result.labels[k]);
+    }
+    for (int k = 0; k < result.keys.size(); k++)
+    {
+        columns[k].insert(columns[k].end(), result.keys[k].begin(), result.keys[k].end());
+    }
+    char digits[32];
+    for (int a = 0; a < result.values.size(); a++)
+    {
+        vector<string>& column = columns[result.keys.size() + a];
+        for (int g = 0; g < result.values[a].size(); g++)
+        {
+            double value = result.values[a][g];
+            if (value != value)
+            {
+                column.push_back("");
+                continue;
+            }
+            int length = snprintf(digits, sizeof(digits), "%.15g", value);
+            column.push_back(string(digits, length));
+        }
+    }
+    return columns;
+}
+
+// here are the protected helper functions
+
+void TableQuery::convertRows(const vector<string>& column, int firstRow, int lastRow, vector<double>& out)
+{
+    // this runs on several threads at once in getNumbers(), each with its own range of out
+    for (int row = firstRow; row < lastRow; row++)
+    {
+        out[row - firstDataRow] = parseNumber(column[row]);
+    }
+}
+
+// Without grouping, the loop keeps running totals in local variables and has no branches, so the compiler can vectorize it.
+// With grouping, each row's totals go to its group's slot in the state.
+void TableQuery::aggregateRows(const vector<double>& values, const vector<int>& groupIds, int firstRow, int lastRow, AggregateState& state)
+{
+    const double* v = values.data();
+    const char* sel = filtered ? selection.data() : NULL;
+    const double infinity = numeric_limits<double>::infinity();
+    if (groupIds.empty())
+    {
+        double sum = 0.0;
+        long long count = 0;
+        double low = infinity;
+        double high = -infinity;
+        for (int i = firstRow; i < lastRow; i++)
+        {
+            bool use = (v[i] == v[i]) & ((sel == NULL) || (sel[i] != 0));
+            double value = use ? v[i] : 0.0;
+            sum += value;
+            count += use;
+            low = (use && value < low) ? value : low;
+            high = (use && value > high) ? value : high;
+        }
+        state.sums[0] += sum;
+        state.counts[0] += count;
+        state.mins[0] = min(state.mins[0], low);
+        state.maxes[0] = max(state.maxes[0], high);
+        return;
+    }
+    const int* ids = groupIds.data();
+    double* sums = state.sums.data();
+    long long* counts = state.counts.data();
+    double* mins = state.mins.data();
+    double* maxes = state.maxes.data();
+    for (int i = firstRow; i < lastRow; i++)
+    {
+        if (v[i] != v[i] || (sel != NULL && sel[i] == 0))
+        {
+            continue;
+        }
+        int g = ids[i];
+        sums[g] += v[i];
+        counts[g]++;
+        if (v[i] < mins[g])
+        {
+            mins[g] = v[i];
+        }
+        if (v[i] > maxes[g])
+        {
+            maxes[g] = v[i];
+        }
+    }
+}
+
+void TableQuery::startSelection()
+{
+    if (! filtered)
+    {
+        selection.assign(numDataRows, 1);
+        filtered = true;
+    }
+}
+
+// With one grouping column, its codes are the group ids. Each further column splits the groups again, using a hash table
+// keyed on the pair (group so far, code in this column).
+void TableQuery::assignGroups(vector<int>& groupIds, vector< vector<int> >& groupCodes)
+{
+    const EncodedColumn& first = getEncoded(groupColumns[0]);
+    groupIds = first.codes;
+    groupCodes.clear();
+    for (int code = 0; code < first.dictionary.size(); code++)
+    {
+        groupCodes.push_back(vector<int>(1, code));
+    }
+    for (int k = 1; k < groupColumns.size(); k++)
+    {
+        const EncodedColumn& encoded = getEncoded(groupColumns[k]);
+        unordered_map<unsigned long long, int> combined;
+        vector< vector<int> > newCodes;
+        for (int i = 0; i < numDataRows; i++)
+        {
+            unsigned long long key = ((unsigned long long)groupIds[i] << 32) | (unsigned int)encoded.codes[i];
+            pair<unordered_map<unsigned long long, int>::iterator, bool> inserted = combined.insert(make_pair(key, (int)newCodes.size()));
+            if (inserted.second)
+            {
+                newCodes.push_back(groupCodes[groupIds[i]]);
+                newCodes.back().push_back(encoded.codes[i]);
+            }
+            groupIds[i] = inserted.first->second;
+        }
+        groupCodes.swap(newCodes);
+    }
+}
+
+string TableQuery::columnLabel(int col)
+{
+    if (reader.hasHeaderRow())
+    {
+        return reader.getColNames().at(col);
+    }
+    return boost::lexical_cast<string>(col);
+}
@@ -0,0 +1,115 @@
+// header file for TableQuery class
+#ifndef _TABLE_QUERY_
+#define _TABLE_QUERY_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "readerExcept.h"
+
+// forward declarations, for sanity
+class TableReader;
+
+// what to compute over the rows of each group
+enum AggregateOp
+{
+    AGG_COUNT, // the number of rows with a number in the column. Give column -1 to count every row.
+    AGG_SUM,
+    AGG_MIN,
+    AGG_MAX,
+    AGG_MEAN
+};
+
+// how where() compares a column against a number
+enum CompareOp
+{
+    CMP_EQUAL,
+    CMP_NOT_EQUAL,
+    CMP_LESS,
+    CMP_LESS_EQUAL,
+    CMP_GREATER,
+    CMP_GREATER_EQUAL
+};
+
+// one aggregate requested from a TableQuery
+struct Aggregate
+{
+    AggregateOp op;
+    int column; // the column it is computed over, or -1 for AGG_COUNT of every row
+};
+
+// a text column with each distinct value replaced by a small integer code, so that rows can be compared and grouped without comparing strings
+struct EncodedColumn
+{
+    std::vector<int> codes; // the code of each data row's value
+    std::vector<std::string> dictionary; // the value of each code, in order of first appearance
+    std::unordered_map<std::string, int> lookup; // the code of each value
+};
+
+// the answer to TableQuery::run(). Groups come out in the order they first appear in the table.
+struct QueryResult
+{
+    std::vector<std::string> labels; // the label of each group-by column, then of each aggregate, such as "sum(price)"
+    std::vector< std::vector<std::string> > keys; // keys[k][g] is the value of the k'th group-by column for group g
+    std::vector< std::vector<double> > values; // values[a][g] is the a'th aggregate for group g. NaN where there were no numbers to aggregate.
+    std::vector<long long> groupSizes; // the number of selected rows in each group
+};
+
+// partial sums, counts, minimums and maximums of one column, one entry per group. Each thread fills its own, and they are merged at the end.
+struct AggregateState
+{
+    std::vector<double> sums;
+    std::vector<long long> counts;
+    std::vector<double> mins;
+    std::vector<double> maxes;
+};
+
+// filters, groups and aggregates the columns of a TableReader that has already made its columns.
+// Columns are converted to typed arrays once, the first time a query uses them, and reused by every query after that.
+class TableQuery
+{
+    public:
+        TableQuery(TableReader& inReader); // the reader must stay alive, and must not be reloaded, while the query is in use. Call clearCache() after a reload.
+        virtual ~TableQuery();
+        virtual void setNumThreads(int inThreads); // sets how many threads convert columns and aggregate rows. Defaults to 1.
+        // building a query. Filters are combined with AND.
+        virtual void where(int col, CompareOp op, double value); // keeps only rows whose field in col compares true against value. Rows without a number in col are dropped.
+        virtual void where(const std::string& name, CompareOp op, double value); // same as above, for a labelled column
+        virtual void whereEquals(int col, const std::string& value); // keeps only rows whose field in col is exactly value
+        virtual void whereEquals(const std::string& name, const std::string& value); // same as above, for a labelled column
+        virtual void groupBy(int col); // adds a column to group rows by. With no grouping columns, all selected rows form one group.
+        virtual void groupBy(const std::string& name); // same as above, for a labelled column
+        virtual void addAggregate(AggregateOp op, int col); // adds an aggregate to compute for each group. Column -1 is only allowed for AGG_COUNT; anything else throws QueryError.
+        virtual void addAggregate(AggregateOp op, const std::string& name); // same as above, for a labelled column
+        virtual QueryResult run(); // computes the aggregates over the selected rows
+        virtual void clearQuery(); // removes every filter, grouping column and aggregate, but keeps the converted columns
+        virtual void clearCache(); // clearQuery(), and throws away the converted columns as well
+        // "get" methods:
+        virtual const std::vector<double>& getNumbers(int col); // returns a column converted to numbers, one per data row. NaN where the field is empty or not a number.
+        virtual const EncodedColumn& getEncoded(int col); // returns a column with its values replaced by codes
+        virtual const std::vector<char>& getSelection(); // for each data row, 1 if it passed every filter so far, otherwise 0
+        virtual long getNumSelected(); // returns the number of rows that passed every filter so far
+        virtual int getNumDataRows(); // returns the number of rows of data in the table, not counting a header row
+        virtual int getNumThreads(); // returns the value of numThreads
+        virtual std::vector< std::vector<std::string> > formatResult(const QueryResult& result); // lays a result out like TableReader::rawCols, with the labels in the first row, ready for TableWriter::writeColumns()
+    protected:
+        // helper functions:
+        virtual void convertRows(const std::vector<std::string>& column, int firstRow, int lastRow, std::vector<double>& out); // converts rows [firstRow, lastRow) of column into out, starting at out[firstRow - firstDataRow]
+        virtual void aggregateRows(const std::vector<double>& values, const std::vector<int>& groupIds, int firstRow, int lastRow, AggregateState& state); // adds selected data rows [firstRow, lastRow) of values into state. groupIds is empty if there is only one group.
+        virtual void startSelection(); // selects every row, if no filter has been applied yet
+        virtual void assignGroups(std::vector<int>& groupIds, std::vector< std::vector<int> >& groupCodes); // works out which group each data row is in, and the codes of each group's key
+        virtual std::string columnLabel(int col); // the column's label from the header row, or its index if there is no header row
+        // data members
+        TableReader& reader; // the table being queried
+        int numThreads; // how many threads to convert and aggregate with
+        int firstDataRow; // the first row of the reader's columns that holds data, rather than labels
+        int numDataRows; // how many rows of data the table has
+        std::unordered_map<int, std::vector<double> > numberColumns; // the columns that have been converted to numbers, by column index
+        std::unordered_map<int, EncodedColumn> encodedColumns; // the columns that have been encoded, by column index
+        std::vector<char> selection; // for each data row, whether it has passed every filter. Empty until the first filter is applied.
+        bool filtered; // whether any filter has been applied since the last clearQuery()
+        std::vector<int> groupColumns; // the columns to group by, in order
+        std::vector<Aggregate> aggregates; // the aggregates to compute, in order
+};
+
+#endif
@@ -1,14 +1,60 @@
 #include "tableReader.h"
+#include "joinGuard.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // implementation for TableReader class
 
 using namespace std;
 
+// in lazy mode, the start of every fieldIndexStride'th field of each row is recorded
+static const int fieldIndexStride = 8;
+// marks a field that a short row doesn't have, in fieldCheckpoints
+static const uint32_t noField = RecordView::missingField;
+
+// the default settings: the delimiter is guessed, rows with too few fields throw, and there is no memory budget.
+// The spill directory is left empty, and looked up when the spill file is opened, so that a moved-from reader can be given the defaults without allocating.
+ReaderSettings::ReaderSettings() : autoDelim(true), delim("NO_DELIMITER"), badRowPolicy(THROW_ON_BAD_ROW), headerMode(HEADER_AUTO), memoryBudget(0), lazyColumns(false), rowLayout(false),
+    validateUtf8(true), hasSuppliedProfile(false)
+{
+}
+
+// the data of a reader that hasn't loaded anything. C++'s default initializations are fine for the containers.
+ReaderData::ReaderData() : filename("NO_FILE"), numCols(0), finderCode(-10), hasHeader(false), rowBytes(0), cellBytes(0), spilledRows(0), spilledColRows(0),
+    indexStride(fieldIndexStride), numCheckpoints(0), numIndexedRows(0), dataStartOffset(0), profileInUse(-1)
+{
+}
+
 // default constructor
-TableReader::TableReader() : filename("NO_FILE"), autoDelim(true), delim("NO_DELIMITER"), finderCode(-10)
+TableReader::TableReader()
+{
+    // Sets the filename to "NO_FILE", the delimiter to "NO_DELIMITER", and autoDelim to true, through ReaderSettings and ReaderData.
+}
+
+// move constructor. Takes over other's settings, data and buffers without copying them; nothing is allocated, profiles included.
+// other is left with the default settings, reset and ready to load another file.
+TableReader::TableReader(TableReader&& other) noexcept : ReaderSettings(move(other)), ReaderData(move(other))
+{
+    static_cast<ReaderSettings&>(other) = ReaderSettings();
+    other.reset();
+}
+
+// move assignment. The same as the move constructor; this reader's old settings, data and buffers are freed.
+TableReader& TableReader::operator=(TableReader&& other) noexcept
 {
-    // Sets the filename to "NO_FILE", the delimiter to "NO_DELIMITER", and autoDelim to true
-    // C++'s default initializations are fine for everything else.
+    if (this != &other)
+    {
+        ReaderSettings::operator=(move(other));
+        ReaderData::operator=(move(other));
+        static_cast<ReaderSettings&>(other) = ReaderSettings();
+        other.reset();
+    }
+    return *this;
 }
 
 // destructor
@@ -44,6 +90,94 @@ void TableReader::unsetDelim()
     autoDelim = true;
 }
 
+// Forgets the loaded file and everything worked out from it, so that another file can be loaded.
+// Settings (a delimiter given to setDelim(), the bad row policy and the header mode) are kept.
+// The row strings and column vectors are kept too, emptied, so the next load can reuse their memory. Row strings are not kept if there is a memory budget, since they would hold on to memory the budget doesn't see.
+void TableReader::reset()
+{
+    if (dataFile.is_open())
+    {
+        dataFile.close();
+    }
+    dataFile.clear();
+    filename = "NO_FILE";
+    if (autoDelim)
+    {
+        delim = "NO_DELIMITER";
+    }
+    if (memoryBudget == 0)
+    {
+        for (int r = 0; r < rawRows.size(); r++)
+        {
+            spareRows.push_back(move(rawRows[r]));
+        }
+    }
+    rawRows.clear();
+    recycleColumns();
+    clearSpill();
+    fieldCheckpoints.clear();
+    indexedRows.clear();
+    numIndexedRows = 0;
+    materialized.clear();
+    rowEndLengths.clear();
+    dataStartOffset = 0;
+    profileInUse = -1;
+    numCols = 0;
+    finderCode = -10;
+    badRows.clear();
+    warnings.clear();
+    hasHeader = false;
+    colTypes.clear();
+    colIndex.clear();
+}
+
+// the same as calling reset() and then loadData()
+void TableReader::reload(string inFilename)
+{
+    reset();
+    loadData(inFilename);
+}
+
+// Gives back the memory held on to by reset() for later loads. Useful after loading one unusually large file.
+void TableReader::releaseBuffers()
+{
+    vector<string>().swap(spareRows);
+    vector< vector<string> >().swap(spareCols);
+    vector< vector<string> >().swap(pagedCells);
+    vector< vector<string> >().swap(assembledCols);
+    vector<char>().swap(readBuffer);
+    pagedSegment.assign(pagedSegment.size(), -1);
+    rawRows.shrink_to_fit();
+    rawCols.shrink_to_fit();
+}
+
+// Sets roughly how many bytes the rows and fields may take up in memory. Past that, finished rows and column segments are moved out to a temporary file,
+// and read back from it when they are needed. Loading gets slower, but memory use stays close to the budget.
+void TableReader::setMemoryBudget(size_t inBytes)
+{
+    memoryBudget = inBytes;
+}
+
+void TableReader::setSpillDirectory(const string& inDirectory)
+{
+    spillDirectory = inDirectory;
+}
+
+size_t TableReader::getMemoryBudget()
+{
+    return memoryBudget;
+}
+
+size_t TableReader::getMemoryInUse()
+{
+    return rowBytes + cellBytes;
+}
+
+bool TableReader::hasSpilled()
+{
+    return spilledRows > 0 || spilledColRows > 0;
+}
+
 // returns the delimiter being used by the TableReader object. Returns "NO_DELIMITER" if no delimiter has been set.
 string TableReader::getDelim()
 {
@@ -59,13 +193,22 @@ string TableReader::getFilename()
 // returns the raw, unprocessed text of one row of data
 string TableReader::getRawRow(int index)
 {
-    return rawRows[index]; // make sure this throws an error if index is out of range
+    if (index < 0 || index >= getNumRawRows())
+    {
+        throw ColumnError(filename, index);
+    }
+    if (index < spilledRows)
+    {
+        int segment = findSegment(rowSegmentStarts, index);
+        return spillFile->getItem(rowSegments[segment], index - rowSegmentStarts[segment]).to_string();
+    }
+    return rawRows[index - spilledRows];
 }
 
 // returns the number of raw rows, or, the number of lines of data read from the file
 int TableReader::getNumRawRows()
 {
-    return rawRows.size();
+    return spilledRows + rawRows.size();
 }
 
 // returns the number of columns in the data table
@@ -74,19 +217,319 @@ int TableReader::getNumCols()
     return numCols;
 }
 
-// returns the set of raw (as in, string) columns
+// returns the number of rows that were split into columns
+int TableReader::getNumRows()
+{
+    if (lazyColumns || rowLayout)
+    {
+        return numIndexedRows;
+    }
+    return spilledColRows + (rawCols.empty() ? 0 : rawCols[0].size());
+}
+
+// returns the set of raw (as in, string) columns. If the table has spilled, this reads the whole table back into memory.
 vector< vector<string> > TableReader::getRawCols()
 {
-    return rawCols;
+    materializeAllColumns();
+    if (spilledColRows == 0)
+    {
+        return rawCols;
+    }
+    vector< vector<string> > allCols;
+    for (int k = 0; k < rawCols.size(); k++)
+    {
+        allCols.push_back(getColumn(k));
+    }
+    return allCols;
+}
+
+// sets how makeRawColumns() decides whether the first row holds column labels
+void TableReader::setHeaderMode(HeaderMode inMode)
+{
+    headerMode = inMode;
+}
+
+// The profile is tried by the next makeRawColumns() whatever the file is called, but still has to pass the check on the first rows.
+void TableReader::useSchemaProfile(const SchemaProfile& inProfile)
+{
+    if (hasSuppliedProfile)
+    {
+        profiles[0] = inProfile;
+    }
+    else
+    {
+        profiles.insert(profiles.begin(), inProfile);
+        hasSuppliedProfile = true;
+    }
+}
+
+void TableReader::addSchemaProfile(const SchemaProfile& inProfile)
+{
+    profiles.push_back(inProfile);
+}
+
+void TableReader::clearSchemaProfiles()
+{
+    profiles.clear();
+    hasSuppliedProfile = false;
+    profileInUse = -1;
+}
+
+// sets what makeRawColumns() does when a row has the wrong number of fields
+void TableReader::setBadRowPolicy(BadRowPolicy inPolicy)
+{
+    badRowPolicy = inPolicy;
+}
+
+BadRowPolicy TableReader::getBadRowPolicy()
+{
+    return badRowPolicy;
+}
+
+// returns the log of rows that had too few or too many fields. Only filled in when badRowPolicy is not THROW_ON_BAD_ROW.
+vector<BadRow> TableReader::getBadRows()
+{
+    return badRows;
+}
+
+int TableReader::getNumBadRows()
+{
+    return badRows.size();
+}
+
+// returns the warnings raised while guessing the delimiter
+vector<string> TableReader::getWarnings()
+{
+    return warnings;
+}
+
+bool TableReader::hasHeaderRow()
+{
+    return hasHeader;
+}
+
+int TableReader::getFirstDataRow()
+{
+    return hasHeader ? 1 : 0;
+}
+
+// returns the column labels, in column order
+vector<string> TableReader::getColNames()
+{
+    vector<string> names;
+    string scratch;
+    if (hasHeader)
+    {
+        for (int k = 0; k < rawCols.size(); k++)
+        {
+            names.push_back(peekCell(k, 0, scratch));
+        }
+    }
+    return names;
+}
+
+// Describes the table as it was made, so that the next file from the same feed can skip the detection. A profile that was used keeps its name and pattern.
+// A profile is only any use with a delimiter, so a table that was taken as a single column, with none found, doesn't get one.
+SchemaProfile TableReader::getSchemaProfile()
+{
+    if (delim == "NO_DELIMITER")
+    {
+        throw NoDelimsError(filename);
+    }
+    SchemaProfile profile;
+    if (profileInUse >= 0)
+    {
+        profile.name = profiles[profileInUse].name;
+        profile.filenamePattern = profiles[profileInUse].filenamePattern;
+        profile.filenameRegex = profiles[profileInUse].filenameRegex;
+    }
+    profile.delim = delim;
+    profile.numCols = numCols;
+    profile.hasHeader = hasHeader;
+    if (hasHeader)
+    {
+        profile.headerLine = getRawRow(0);
+    }
+    profile.colTypes = colTypes;
+    return profile;
+}
+
+bool TableReader::usedSchemaProfile()
+{
+    return profileInUse >= 0;
+}
+
+string TableReader::getProfileName()
+{
+    return (profileInUse >= 0) ? profiles[profileInUse].name : string();
+}
+
+// looks up a column by its label. A single hash lookup, so it costs about the same no matter how many columns there are.
+int TableReader::getColIndex(const string& name)
+{
+    unordered_map<string, int>::const_iterator found = colIndex.find(name);
+    if (found == colIndex.end())
+    {
+        throw ColumnError(filename, name);
+    }
+    return found->second;
+}
+
+bool TableReader::hasColumn(const string& name)
+{
+    return colIndex.count(name) > 0;
+}
+
+ColumnType TableReader::getColType(int col)
+{
+    return colTypes.at(col);
+}
+
+// A column still in memory is returned straight from rawCols. A spilled column is put back together once, into its own entry of
+// assembledCols, so references to different columns never share one, and every reference lasts until the columns are made again.
+const vector<string>& TableReader::getColumn(int col)
+{
+    if (! materialized.at(col))
+    {
+        materializeColumn(col);
+    }
+    if (spilledColRows == 0)
+    {
+        return rawCols.at(col);
+    }
+    if (assembledCols.size() != rawCols.size())
+    {
+        assembledCols.resize(rawCols.size());
+    }
+    vector<string>& fullColumn = assembledCols[col];
+    if (fullColumn.empty())
+    {
+        fullColumn.reserve(getNumRows());
+        for (int segment = 0; segment < colSegments.at(col).size(); segment++)
+        {
+            spillFile->readSegment(colSegments[col][segment], fullColumn);
+        }
+        fullColumn.insert(fullColumn.end(), rawCols[col].begin(), rawCols[col].end());
+    }
+    return fullColumn;
+}
+
+const vector<string>& TableReader::getColumn(const string& name)
+{
+    return getColumn(getColIndex(name));
+}
+
+const string& TableReader::getCell(int col, int row)
+{
+    if (col < 0 || col >= numCols || row < 0 || row >= getNumRows())
+    {
+        throw ColumnError(filename, col, row);
+    }
+    if (! materialized[col])
+    {
+        materializeColumn(col);
+    }
+    if (row >= spilledColRows)
+    {
+        return rawCols[col][row - spilledColRows];
+    }
+    return pageInCell(col, row);
+}
+
+const string& TableReader::getCell(const string& name, int row)
+{
+    return getCell(getColIndex(name), row);
+}
+
+// picks out the named columns. The result has the same layout as rawCols, header row included.
+vector< vector<string> > TableReader::projectColumns(const vector<string>& names)
+{
+    vector< vector<string> > projected;
+    projected.reserve(names.size());
+    for (int n = 0; n < names.size(); n++)
+    {
+        projected.push_back(getColumn(names[n]));
+    }
+    return projected;
+}
+
+// finds the rows of data (never the header) whose field in the named column passes the test
+vector<int> TableReader::filterRows(const string& name, function<bool (const string&)> keep)
+{
+    int col = getColIndex(name);
+    int numRows = getNumRows();
+    vector<int> kept;
+    for (int row = getFirstDataRow(); row < numRows; row++)
+    {
+        if (keep(getCell(col, row)))
+        {
+            kept.push_back(row);
+        }
+    }
+    return kept;
+}
+
+// A record is the row's own text and its run of offsets in the field index, so a consumer going through the table row by row
+// reads each row's bytes and offsets from one place each, instead of one field from every column.
+// Row layout mode is never used on spilled rows, so every row is in rawRows.
+RecordView TableReader::getRecord(int row)
+{
+    if (indexStride != 1)
+    {
+        throw LayoutError(filename);
+    }
+    if (row < 0 || row >= numIndexedRows)
+    {
+        throw LayoutError(filename, row);
+    }
+    const string& text = rawRows[indexedRows[row]];
+    return RecordView(text.data(), text.size(), &fieldCheckpoints[row * numCheckpoints], numCols, delim.size(), row);
+}
+
+RecordIterator TableReader::beginRecords()
+{
+    if (indexStride != 1)
+    {
+        throw LayoutError(filename);
+    }
+    return RecordIterator(this, getFirstDataRow());
+}
+
+RecordIterator TableReader::endRecords()
+{
+    return RecordIterator(this, getNumRows());
+}
+
+void TableReader::exportArrow(ArrowSchema* outSchema, ArrowArray* outArray)
+{
+    vector<int> cols;
+    for (int k = 0; k < rawCols.size(); k++)
+    {
+        cols.push_back(k);
+    }
+    exportArrow(cols, outSchema, outArray);
+}
+
+// The first export of a column packs it; every export after that only hands out another reference to the packed buffers.
+void TableReader::exportArrow(const vector<int>& cols, ArrowSchema* outSchema, ArrowArray* outArray)
+{
+    if (! arrowExporter)
+    {
+        arrowExporter.reset(new ArrowExporter());
+    }
+    arrowExporter->exportColumns(*this, cols, outSchema, outArray);
 }
 
+// Reads the file in large blocks. A single pass over each block finds the line endings and checks that the text is valid UTF-8.
+// Where SSE2 is available, the pass looks at 16 bytes at a time, and only hands blocks with non-ASCII bytes to the UTF-8 validator.
+// Lines may end in LF, CRLF or a lone CR; none of those characters end up in the rows. A UTF-8 byte order mark at the start of the file is skipped.
 void TableReader::loadData(string inFilename)
 {
     // sets filename to the name of the file entered. Checks if the file is already open. Opens it if it is not.
     filename = inFilename;
     if (! dataFile.is_open())
     {
-        dataFile.open(inFilename.c_str());  // C++ file io is bad about exceptions--in that it doesn't really throw any. You need to check the state of the file using " if dataFile.bad() " for reading and writing failure, and " if dataFile.eof() " fro what to do at the end of a file. You can throw an exception inside the if-statements.
+        dataFile.open(inFilename.c_str(), ios::in | ios::binary);  // C++ file io is bad about exceptions--in that it doesn't really throw any. You need to check the state of the file using " if dataFile.bad() " for reading and writing failure, and " if dataFile.eof() " fro what to do at the end of a file. You can throw an exception inside the if-statements.
         // Now, the file should be open no matter what. Check. If it's still not open, throw an exception.
         if (! dataFile.is_open())
         {
@@ -95,46 +538,191 @@ void TableReader::loadData(string inFilename)
 
     }
 
-    int linecount = 0;
-    while (dataFile.good())
+    const size_t chunkSize = 1 << 20;
+    readBuffer.resize(chunkSize);
+    Utf8Validator validator;
+    bool checking = validateUtf8; // turned off after the first bad byte, so a badly encoded file only gets one warning
+    bool firstChunk = true;
+    bool afterCR = false; // whether the last chunk ended in a CR, which may be the first half of a CRLF
+    long long chunkOffset = 0; // where the current chunk starts in the file
+    dataStartOffset = 0;
+    startRow();
+    while (true)
+    {
+        dataFile.read(&readBuffer[0], chunkSize);
+        size_t length = dataFile.gcount();
+        if (length == 0)
+        {
+            break;
+        }
+        const char* pos = &readBuffer[0];
+        const char* end = pos + length;
+        if (firstChunk)
+        {
+            firstChunk = false;
+            if (length >= 3 && (unsigned char)pos[0] == 0xEF && (unsigned char)pos[1] == 0xBB && (unsigned char)pos[2] == 0xBF)
+            {
+                pos += 3;
+                dataStartOffset = 3;
+            }
+        }
+        const char* lineStart = pos;
+        if (afterCR && *pos == '\n')
+        {
+            // the second half of a CRLF that was split between chunks
+            rowEndLengths.back() = 2;
+            lineStart = pos + 1;
+        }
+        afterCR = false;
+
+        // handles a CR or LF found at p. A LF right after a CR belongs to the same line ending.
+        auto endLine = [&](const char* p)
+        {
+            if (p < lineStart)
+            {
+                return; // the LF of a CRLF that has already been handled
+            }
+            int endLength = 1;
+            if (*p == '\r')
+            {
+                if (p + 1 == end)
+                {
+                    afterCR = true;
+                }
+                else if (p[1] == '\n')
+                {
+                    endLength = 2;
+                }
+            }
+            finishRow(lineStart, p, endLength);
+            lineStart = p + endLength;
+        };
+
+#ifdef __SSE2__
+        const __m128i newlines = _mm_set1_epi8('\n');
+        const __m128i returns = _mm_set1_epi8('\r');
+        while (pos + 16 <= end)
+        {
+            __m128i block = _mm_loadu_si128((const __m128i*)pos);
+            // the top bit of every byte: set for anything that isn't ASCII
+            int highBits = _mm_movemask_epi8(block);
+            if (checking && (highBits != 0 || validator.inCharacter()))
+            {
+                if (! validator.validate(pos, 16, chunkOffset + (pos - &readBuffer[0])))
+                {
+                    reportEncodingError(validator.getErrorOffset());
+                    checking = false;
+                }
+            }
+            int lineBits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, newlines), _mm_cmpeq_epi8(block, returns)));
+            while (lineBits != 0)
+            {
+                endLine(pos + __builtin_ctz(lineBits));
+                lineBits &= lineBits - 1;
+            }
+            pos += 16;
+        }
+#endif
+        // whatever is left over (or all of it, without SSE2) is done a byte at a time
+        if (checking && pos < end)
+        {
+            if (! validator.validate(pos, end - pos, chunkOffset + (pos - &readBuffer[0])))
+            {
+                reportEncodingError(validator.getErrorOffset());
+                checking = false;
+            }
+        }
+        for (; pos < end; pos++)
+        {
+            if (*pos == '\n' || *pos == '\r')
+            {
+                endLine(pos);
+            }
+        }
+        // the rest of the chunk is the start of a row that carries on into the next chunk
+        if (lineStart < end)
+        {
+            rawRows.back().append(lineStart, end - lineStart);
+        }
+        chunkOffset += length;
+    }
+    // now, make sure that you didn't stop reading before reaching the end of the file. if you did, it's because there was an error reading the file.
+    if (dataFile.bad() || ! dataFile.eof())
     {
-        linecount++;
-        string row;
-        getline(dataFile, row); // C++ file io is bad about exceptions--in that it doesn't really throw any. You need to check the state of the file using " if dataFile.bad() " for reading and writing failure, and " if dataFile.eof() " fro what to do at the end of a file. You can throw an exception inside the if-statements.
-        rawRows.push_back(row);
+        throw FileReadError(filename, getNumRawRows());
     }
-    // now, make sure that you didn't break out of the while loop before reaching the end of the file. if you did, it's because there was an error reading the file.
-    if (! dataFile.eof())
+    if (checking && ! validator.finish(chunkOffset))
     {
-        throw FileReadError(filename, linecount);
+        reportEncodingError(validator.getErrorOffset());
     }
 
-    // make sure you don't have an empty string at the end, messing things up
-    int lastrow = rawRows.size() - 1;
-    if (rawRows[lastrow] == "")
+    // The last row had no line ending after it. If it's empty, the file ended with a line ending, so there is no last row.
+    if (rawRows.back().empty())
+    {
+        spareRows.push_back(move(rawRows.back()));
+        rawRows.pop_back();
+    }
+    else
     {
-        rawRows.erase(rawRows.begin() + lastrow);
+        rowEndLengths.push_back(0);
+        rowBytes += memoryCost(rawRows.back());
     }
     // You're done with the file -- all the data is loaded in
     dataFile.close();
+    dataFile.clear();
 
 }
 // makes columns of data.
 void TableReader::makeRawColumns()
 {
+    // Lazy columns are split out one at a time, whenever they are first used, so they can't be spilled a segment at a time like the others.
+    if (lazyColumns && memoryBudget > 0)
+    {
+        throw SettingsError(filename, "lazy mode can't be used with a memory budget");
+    }
+    // Row layout splits its columns out the same way, and its field offsets, one for every field, are never spilled either.
+    if (rowLayout && memoryBudget > 0)
+    {
+        throw SettingsError(filename, "row layout mode can't be used with a memory budget");
+    }
+    // nor on rows that loadData() spilled under a budget that has since been lifted, so records always point into rawRows
+    if (rowLayout && spilledRows > 0)
+    {
+        throw SettingsError(filename, "row layout mode can't be used on rows that were spilled while loading");
+    }
+    // Start from scratch if columns were already made from this data
+    recycleColumns();
+    clearColumnSpill();
+    badRows.clear();
+
     // STEP ONE: Establish how many columns there are in the data table.
 
-    // First, check if autoDelim is set to true. If it is, create a DelimFinder object and find the delim character:
-    if (autoDelim)
+    // A schema profile that fits the file already says what the delimiter is and how many columns there are, so nothing needs to be worked out.
+    profileInUse = findSchemaProfile();
+    if (profileInUse >= 0)
+    {
+        delim = profiles[profileInUse].delim;
+        numCols = profiles[profileInUse].numCols;
+        for (int n = 0; n < numCols; n++)
+        {
+            addEmptyColumn();
+        }
+    }
+    // Otherwise, check if autoDelim is set to true. If it is, create a DelimFinder object and find the delim character:
+    else if (autoDelim)
     {
         //cout << "Automatically guessing delim..." << endl;
         DelimFinder newfinder(*this);
         finderCode = newfinder.guessDelim();
-        // guessDelim automatically sets the value of numCols. Now, just add that number of empty vectors to rawCols:
+        // guessDelim automatically sets the value of numCols. If it found no delimiter, the whole row is one column.
+        if (numCols < 1)
+        {
+            numCols = 1;
+        }
+        // Now, just add that number of empty vectors to rawCols:
         for (int n = 0; n < numCols; n++)
         {
-            vector<string> emptyColumn;
-            rawCols.push_back(emptyColumn);
+            addEmptyColumn();
         }
     } // end if block -- what to do if autoDelim is set to true
     // Now, there should be a character (or string, if user-set) in the delim field.
@@ -144,12 +732,11 @@ void TableReader::makeRawColumns()
         //cout << "Delimiter already set by user to be " << delim << endl;
         // If autoDelim is false, that means the delimiter was set by the user. It still remains to determine the number of columns in the data table, and to add that number of empty vectors to rawCols.
         numCols = 1;
-        vector<string> emptyColumn;
-        rawCols.push_back(emptyColumn);
+        addEmptyColumn();
         // If there is an identifiable delimiter, the number of columns is equal to the number of times the delimiter appears per row, plus one:
         // item1 <delim> item2 <delim> item3   --> three items, two instances of the delimiter
         // look at the first row of data to determine the number of columns
-        string firstRow = rawRows[0];
+        string firstRow = getRawRow(0);
         size_t delimPos;
         int startPos = 0;
         bool moreCols = true;
@@ -161,7 +748,7 @@ void TableReader::makeRawColumns()
             {
                 // if the delimiter character occurs, make a substring consisting of everything between the last delimiter character (or beginning of the row), and the next one.
                 // add a column to the list rawCols
-                rawCols.push_back(emptyColumn);
+                addEmptyColumn();
                 // increase the column count
                 numCols += 1;
                 // move along to the next place to start searching for delimiters
@@ -181,40 +768,178 @@ void TableReader::makeRawColumns()
     //cout << "The number of vectors in RawCols is " << rawCols.size() << endl;
 
     // STEP TWO: Split each row into its component elements and organize these into columns.
-    for (int rownum = 0; rownum < rawRows.size(); rownum++)
+    int numRawRows = getNumRawRows();
+    if (memoryBudget == 0 && ! lazyColumns && ! rowLayout)
     {
-        // in each row, find each instance of the delimiter
-        string currentRow = rawRows[rownum];
-        int startPos = 0;
-        size_t foundPos;
-        for (int k = 0; k < numCols-1; k++)
+        for (int k = 0; k < numCols; k++)
         {
-            foundPos = currentRow.find(delim, startPos);
-            //cout << "The character matching the delimiter is: " << currentRow[foundPos] << " at position " << foundPos << endl;
-            // if the delimiter is not found, but there should still be more columns to go, throw an error
-            if (foundPos == string::npos)
-            {
-                throw MissingDelimError(filename, rownum);
-            }
-            // if the exception wasn't thrown, move on
-            // make a substring just containing the part of the row in between the delimiters
-            string currentItem = currentRow.substr(startPos, foundPos - startPos);
-            //cout << "The starting position for the substring is " << startPos << " and the ending position is " << foundPos << endl;
-            //cout << "The current item being added to the list is: " << currentItem << endl;
-            // add that substring to the right column and row in rawCols
-            rawCols[k].push_back(currentItem);
-            // move startPos so that the next iteration will find the next delimiter
-            startPos = foundPos + 1;
-
-        } // end of for loop through each row
-        //cout << "Made it to the end of the for loop through row " << rownum << endl;
-        // Now, add in the last column
-        string lastItem = rawRows[rownum].substr(startPos, string::npos);
-        //cout << "The last item in the row is " << lastItem << endl;
-        rawCols[numCols - 1].push_back(lastItem);
-        //cout << "... competed analyzing row " << rownum << endl;
-    } // end for loop through the all the rows
-    //cout << "Broke up the elements in all rows." << endl;
+            rawCols[k].reserve(rawCols[k].size() + numRawRows);
+        }
+    }
+    else if (memoryBudget > 0 && rowBytes > memoryBudget / 2)
+    {
+        // leave at least half of the budget for the columns
+        spillRows();
+    }
+    vector<size_t> fieldEnds(numCols); // where each field of the current row ends. Reused for every row.
+    string scratchRow; // holds the current row, if it has to be read back from the spill file
+    long long rowOffset = dataStartOffset; // where the current row starts in the data file
+    startFieldIndex();
+    for (int rownum = 0; rownum < numRawRows; rownum++)
+    {
+        // in each row, find each instance of the delimiter
+        const string& currentRow = fetchRow(rownum, scratchRow);
+        long long thisRowOffset = rowOffset;
+        rowOffset += currentRow.size() + rowEndLengths[rownum];
+        int k; // the index of the last field found in the row
+        if (! findFields(currentRow, rownum, thisRowOffset, fieldEnds, k))
+        {
+            continue;
+        }
+        // In lazy mode, just remember where some of the fields start; in row layout mode, where all of them do. The columns get split out when they are first used.
+        if (lazyColumns || rowLayout)
+        {
+            indexRow(rownum, k, fieldEnds);
+            continue;
+        }
+        // add the substrings between the delimiters to the right column and row in rawCols
+        size_t fieldStart = 0;
+        for (int f = 0; f < k; f++)
+        {
+            rawCols[f].push_back(currentRow.substr(fieldStart, fieldEnds[f] - fieldStart));
+            fieldStart = fieldEnds[f] + delim.size();
+        }
+        // Now, add in the last field found. In a good row, this is the last column.
+        rawCols[k].push_back(currentRow.substr(fieldStart, string::npos));
+        // pad out a short row, if the policy let it get this far
+        for (int f = k + 1; f < numCols; f++)
+        {
+            rawCols[f].push_back(string());
+        }
+        // once the columns are over the memory budget, move the rows split so far out to the spill file
+        for (int f = 0; f < numCols; f++)
+        {
+            cellBytes += memoryCost(rawCols[f].back());
+        }
+        if (memoryBudget > 0 && rowBytes + cellBytes > memoryBudget)
+        {
+            spillColumns();
+        }
+    } // end for loop through the all the rows
+
+    // STEP THREE: Work out whether the first row is a header, and index the column labels. A profile already knows.
+    if (profileInUse >= 0)
+    {
+        applyProfileHeader(profiles[profileInUse]);
+    }
+    else
+    {
+        detectHeader();
+    }
+}
+
+// Turns lazy column mode on or off. In lazy mode, makeRawColumns() only checks each row and records where some of its fields start.
+// Each column is split out of the rows the first time it is used, by getCell(), getColumn(), getRawCols() or materializeColumns().
+// Lazy mode can't be combined with a memory budget: makeRawColumns() throws SettingsError if both are set.
+void TableReader::setLazyColumns(bool inLazy)
+{
+    lazyColumns = inLazy;
+}
+
+bool TableReader::getLazyColumns()
+{
+    return lazyColumns;
+}
+
+// Turns row layout mode on or off. In row layout mode, makeRawColumns() checks each row and records where every one of its fields starts,
+// one run of offsets per row, so that getRecord() and beginRecords() can hand out the fields of a row without splitting it or copying it.
+// The columns are left to be split out on first use, as in lazy mode.
+void TableReader::setRowLayout(bool inRowLayout)
+{
+    rowLayout = inRowLayout;
+}
+
+bool TableReader::getRowLayout()
+{
+    return rowLayout;
+}
+
+void TableReader::setValidateUtf8(bool inValidate)
+{
+    validateUtf8 = inValidate;
+}
+
+bool TableReader::getValidateUtf8()
+{
+    return validateUtf8;
+}
+
+bool TableReader::isMaterialized(int col)
+{
+    return materialized.at(col) != 0;
+}
+
+// Splits out every listed column that hasn't been split out yet. Several columns are split in parallel, one thread per column.
+// Lazy and row layout modes can't be used with a memory budget, so the rows are all in memory, unless loadData() spilled them
+// under a budget that was lifted before makeRawColumns(). Those are read back through a single mapping, which threads can't share.
+void TableReader::materializeColumns(const vector<int>& cols)
+{
+    vector<int> todo;
+    for (int c = 0; c < cols.size(); c++)
+    {
+        if (! materialized.at(cols[c]) && find(todo.begin(), todo.end(), cols[c]) == todo.end())
+        {
+            todo.push_back(cols[c]);
+        }
+    }
+    int numThreads = thread::hardware_concurrency();
+    if (numThreads > todo.size())
+    {
+        numThreads = todo.size();
+    }
+    if (numThreads <= 1 || spilledRows > 0)
+    {
+        for (int c = 0; c < todo.size(); c++)
+        {
+            materializeColumn(todo[c]);
+        }
+        return;
+    }
+    // each thread takes the next column off the list until there are none left
+    atomic<size_t> nextColumn(0);
+    vector<size_t> threadBytes(numThreads, 0);
+    vector<thread> workers;
+    JoinGuard guard(workers);
+    for (int t = 0; t < numThreads; t++)
+    {
+        workers.push_back(thread([this, &todo, &nextColumn, &threadBytes, t]()
+        {
+            string scratch;
+            for (size_t c = nextColumn++; c < todo.size(); c = nextColumn++)
+            {
+                threadBytes[t] += fillColumn(todo[c], scratch);
+            }
+        }));
+    }
+    guard.joinAll();
+    for (int t = 0; t < numThreads; t++)
+    {
+        cellBytes += threadBytes[t];
+    }
+    for (int c = 0; c < todo.size(); c++)
+    {
+        materialized[todo[c]] = 1;
+    }
+}
+
+void TableReader::materializeAllColumns()
+{
+    vector<int> all;
+    for (int k = 0; k < numCols; k++)
+    {
+        all.push_back(k);
+    }
+    materializeColumns(all);
 }
 
 string TableReader::getDelimFinderInfo()
@@ -244,3 +969,637 @@ string TableReader::getDelimFinderInfo()
 
 // here are the protected helper functions
 
+// adds a message to the list of warnings. Nothing is printed, whatever the bad row policy; rows that don't fit the delimiter go in the bad row log.
+void TableReader::reportWarning(const string& message)
+{
+    warnings.push_back(message);
+}
+
+// A profile applies to a file if it was supplied with useSchemaProfile(), or if its filename pattern or its header row matches.
+// The first profile that applies and passes the check is used. One that applies but fails is reported, and the next is tried.
+int TableReader::findSchemaProfile()
+{
+    if (profiles.empty() || getNumRawRows() == 0)
+    {
+        return -1;
+    }
+    string firstRow = getRawRow(0);
+    for (int p = 0; p < profiles.size(); p++)
+    {
+        bool applies = (p == 0 && hasSuppliedProfile) || profiles[p].matchesFilename(filename) || profiles[p].matchesHeader(firstRow);
+        if (! applies)
+        {
+            continue;
+        }
+        if (checkProfile(profiles[p]))
+        {
+            return p;
+        }
+        reportWarning("Schema profile \"" + profiles[p].name + "\" does not fit the first rows of file " + filename + ". Working out the layout from the data instead.");
+    }
+    return -1;
+}
+
+// A quick check that the file still has the layout in the profile, using only the first few rows: each must have the right
+// number of fields, a header row must be exactly the same, and each field must fit its column's type.
+// Under the lenient bad row policies, rows with the wrong number of fields would only be logged, so they are passed over here
+// too, as long as most of the rows checked do fit.
+bool TableReader::checkProfile(const SchemaProfile& profile)
+{
+    const int checkRows = 10;
+    if (profile.numCols < 1 || profile.delim.empty() || profile.colTypes.size() != profile.numCols)
+    {
+        return false;
+    }
+    // a delimiter set by the user wins over the profile's
+    if (! autoDelim && profile.delim != delim)
+    {
+        return false;
+    }
+    int rowsToCheck = (getNumRawRows() < checkRows) ? getNumRawRows() : checkRows;
+    int dataRows = 0;
+    int badDataRows = 0;
+    for (int row = 0; row < rowsToCheck; row++)
+    {
+        string currentRow = getRawRow(row);
+        if (row == 0 && profile.hasHeader)
+        {
+            if (currentRow != profile.headerLine)
+            {
+                return false;
+            }
+            continue;
+        }
+        dataRows++;
+        // split the row first, so that a row with the wrong number of fields isn't mistaken for one with badly typed fields
+        vector<size_t> fieldStarts(1, 0);
+        size_t fieldEnd = currentRow.find(profile.delim);
+        while (fieldEnd != string::npos && fieldStarts.size() <= profile.numCols)
+        {
+            fieldStarts.push_back(fieldEnd + profile.delim.size());
+            fieldEnd = currentRow.find(profile.delim, fieldStarts.back());
+        }
+        if (fieldStarts.size() != profile.numCols)
+        {
+            if (badRowPolicy == THROW_ON_BAD_ROW)
+            {
+                return false;
+            }
+            badDataRows++;
+            continue;
+        }
+        for (int k = 0; k < profile.numCols; k++)
+        {
+            size_t fieldLength = (k + 1 < profile.numCols) ? fieldStarts[k + 1] - profile.delim.size() - fieldStarts[k] : string::npos;
+            // TYPE_EMPTY is the narrowest type, so an empty field fits any column
+            if (classifyCell(currentRow.substr(fieldStarts[k], fieldLength)) > profile.colTypes[k])
+            {
+                return false;
+            }
+        }
+    }
+    return badDataRows * 2 <= dataRows;
+}
+
+// Takes the header and column types from a profile instead of sampling the rows. HEADER_PRESENT and HEADER_ABSENT still win over the profile.
+void TableReader::applyProfileHeader(const SchemaProfile& profile)
+{
+    hasHeader = profile.hasHeader;
+    if (headerMode == HEADER_PRESENT)
+    {
+        hasHeader = true;
+    }
+    else if (headerMode == HEADER_ABSENT)
+    {
+        hasHeader = false;
+    }
+    if (getNumRows() == 0)
+    {
+        hasHeader = false;
+    }
+    colTypes = profile.colTypes;
+    colIndex.clear();
+    if (hasHeader)
+    {
+        string scratch;
+        for (int k = 0; k < numCols; k++)
+        {
+            // if two columns have the same label, the first one keeps it
+            colIndex.insert(make_pair(peekCell(k, 0, scratch), k));
+        }
+    }
+}
+
+// Decides whether the first row holds column labels. In HEADER_AUTO mode, a sample of the rows below the first is used to infer a type for each column.
+// If any column holds numbers below the first row, but text in the first row, the first row is a header.
+// A table made up entirely of text columns can't be told apart this way, so it is taken to have no header. Use HEADER_PRESENT for those.
+void TableReader::detectHeader()
+{
+    const int sampleRows = 100; // how many rows below the first to look at
+    hasHeader = false;
+    colTypes.assign(numCols, TYPE_EMPTY);
+    colIndex.clear();
+    int numRows = getNumRows();
+    if (numRows == 0)
+    {
+        return;
+    }
+    string scratch; // holds fields of columns that haven't been split out yet, so that detecting the header doesn't force every column to be
+    int sampleEnd = (numRows < sampleRows + 1) ? numRows : sampleRows + 1;
+    // infer a type for each column from the sample, leaving out the first row
+    for (int k = 0; k < numCols; k++)
+    {
+        ColumnType colType = TYPE_EMPTY;
+        for (int row = 1; row < sampleEnd && colType != TYPE_TEXT; row++)
+        {
+            ColumnType cellType = classifyCell(peekCell(k, row, scratch));
+            // integers widen to reals, and anything widens to text
+            if (cellType > colType)
+            {
+                colType = cellType;
+            }
+        }
+        colTypes[k] = colType;
+    }
+    if (headerMode == HEADER_PRESENT)
+    {
+        hasHeader = true;
+    }
+    else if (headerMode == HEADER_AUTO)
+    {
+        for (int k = 0; k < numCols && ! hasHeader; k++)
+        {
+            if ((colTypes[k] == TYPE_INTEGER || colTypes[k] == TYPE_REAL) && classifyCell(peekCell(k, 0, scratch)) == TYPE_TEXT)
+            {
+                hasHeader = true;
+            }
+        }
+    }
+    for (int k = 0; k < numCols; k++)
+    {
+        if (hasHeader)
+        {
+            // if two columns have the same label, the first one keeps it
+            colIndex.insert(make_pair(peekCell(k, 0, scratch), k));
+        }
+        else
+        {
+            // the first row is data, so it counts towards the column's type too
+            ColumnType cellType = classifyCell(peekCell(k, 0, scratch));
+            if (cellType > colTypes[k])
+            {
+                colTypes[k] = cellType;
+            }
+        }
+        // a column with nothing in it is treated as text
+        if (colTypes[k] == TYPE_EMPTY)
+        {
+            colTypes[k] = TYPE_TEXT;
+        }
+    }
+}
+
+// Works out what kind of value a field holds. Leading and trailing whitespace is ignored.
+// Done by hand, rather than with a regex or lexical_cast, because it runs on every field in the sample.
+ColumnType TableReader::classifyCell(const string& cell)
+{
+    size_t pos = 0;
+    size_t end = cell.size();
+    while (pos < end && isspace((unsigned char)cell[pos]))
+    {
+        pos++;
+    }
+    while (end > pos && isspace((unsigned char)cell[end - 1]))
+    {
+        end--;
+    }
+    if (pos == end)
+    {
+        return TYPE_EMPTY;
+    }
+    if (cell[pos] == '+' || cell[pos] == '-')
+    {
+        pos++;
+    }
+    int digits = 0;
+    while (pos < end && isdigit((unsigned char)cell[pos]))
+    {
+        pos++;
+        digits++;
+    }
+    if (pos == end)
+    {
+        return (digits > 0) ? TYPE_INTEGER : TYPE_TEXT;
+    }
+    if (cell[pos] == '.')
+    {
+        pos++;
+        while (pos < end && isdigit((unsigned char)cell[pos]))
+        {
+            pos++;
+            digits++;
+        }
+    }
+    if (digits == 0)
+    {
+        return TYPE_TEXT;
+    }
+    if (pos < end && (cell[pos] == 'e' || cell[pos] == 'E'))
+    {
+        pos++;
+        if (pos < end && (cell[pos] == '+' || cell[pos] == '-'))
+        {
+            pos++;
+        }
+        int expDigits = 0;
+        while (pos < end && isdigit((unsigned char)cell[pos]))
+        {
+            pos++;
+            expDigits++;
+        }
+        if (expDigits == 0)
+        {
+            return TYPE_TEXT;
+        }
+    }
+    return (pos == end) ? TYPE_REAL : TYPE_TEXT;
+}
+
+// Finds the delimiters in a row, up to the number needed for numCols fields, and puts their positions in fieldEnds.
+// lastField is set to the index of the last field found. Rows with the wrong number of fields are dealt with according to badRowPolicy.
+// Returns false if the row should be left out.
+bool TableReader::findFields(const string& row, int rownum, long long rowOffset, vector<size_t>& fieldEnds, int& lastField)
+{
+    size_t startPos = 0;
+    int k = 0;
+    for (; k < numCols-1; k++)
+    {
+        size_t foundPos = row.find(delim, startPos);
+        if (foundPos == string::npos)
+        {
+            break;
+        }
+        fieldEnds[k] = foundPos;
+        // move startPos so that the next iteration will find the next delimiter
+        startPos = foundPos + delim.size();
+    } // end of for loop through the delimiters in the row
+    lastField = k;
+    if (k < numCols-1)
+    {
+        // the delimiter was not found, but there should still be more columns to go
+        if (badRowPolicy == THROW_ON_BAD_ROW)
+        {
+            throw MissingDelimError(filename, rownum);
+        }
+        logBadRow(rownum, k + 1, rowOffset);
+        return (badRowPolicy != SKIP_BAD_ROWS);
+    }
+    if (badRowPolicy != THROW_ON_BAD_ROW && row.find(delim, startPos) != string::npos)
+    {
+        // there are more delimiters left in the row than there should be. Count them for the log.
+        int foundFields = numCols;
+        for (size_t extraPos = row.find(delim, startPos); extraPos != string::npos; extraPos = row.find(delim, extraPos + delim.size()))
+        {
+            foundFields++;
+        }
+        logBadRow(rownum, foundFields, rowOffset);
+        return (badRowPolicy != SKIP_BAD_ROWS);
+    }
+    return true;
+}
+
+// gets the field index ready for makeRawColumns(). Outside lazy mode and row layout mode, there is no index, and every column counts as split out already.
+void TableReader::startFieldIndex()
+{
+    fieldCheckpoints.clear();
+    indexedRows.clear();
+    numIndexedRows = 0;
+    indexStride = rowLayout ? 1 : fieldIndexStride;
+    numCheckpoints = (numCols + indexStride - 1) / indexStride;
+    materialized.assign(numCols, (lazyColumns || rowLayout) ? 0 : 1);
+    if (rowLayout)
+    {
+        fieldCheckpoints.reserve((size_t)getNumRawRows() * numCheckpoints);
+    }
+}
+
+// records where every indexStride'th field of a row starts, so that a column can later be found without scanning the whole row
+void TableReader::indexRow(int rownum, int lastField, const vector<size_t>& fieldEnds)
+{
+    for (int c = 0; c < numCheckpoints; c++)
+    {
+        int field = c * indexStride;
+        if (field == 0)
+        {
+            fieldCheckpoints.push_back(0);
+        }
+        else if (field <= lastField)
+        {
+            fieldCheckpoints.push_back(fieldEnds[field - 1] + delim.size());
+        }
+        else
+        {
+            fieldCheckpoints.push_back(noField);
+        }
+    }
+    indexedRows.push_back(rownum);
+    numIndexedRows++;
+}
+
+// splits one column out of the rows, using the field index. Returns roughly how much memory the fields take up.
+// Several of these can run at once on different columns, as long as no rows have been spilled.
+size_t TableReader::fillColumn(int col, string& scratch)
+{
+    vector<string>& column = rawCols[col];
+    column.clear();
+    column.reserve(numIndexedRows);
+    int checkpoint = col / indexStride;
+    int fieldsToSkip = col % indexStride;
+    size_t bytes = 0;
+    for (int i = 0; i < numIndexedRows; i++)
+    {
+        const string& row = fetchRow(indexedRows[i], scratch);
+        uint32_t pos = fieldCheckpoints[i * numCheckpoints + checkpoint];
+        size_t fieldStart = pos;
+        bool missing = (pos == noField);
+        for (int s = 0; s < fieldsToSkip && ! missing; s++)
+        {
+            size_t foundPos = row.find(delim, fieldStart);
+            if (foundPos == string::npos)
+            {
+                missing = true;
+            }
+            else
+            {
+                fieldStart = foundPos + delim.size();
+            }
+        }
+        if (missing)
+        {
+            // a short row that was padded
+            column.push_back(string());
+        }
+        else if (col == numCols - 1)
+        {
+            // the last column gets the rest of the row, the same as when the columns are split all at once
+            column.push_back(row.substr(fieldStart, string::npos));
+        }
+        else
+        {
+            size_t fieldEnd = row.find(delim, fieldStart);
+            column.push_back(row.substr(fieldStart, (fieldEnd == string::npos) ? string::npos : fieldEnd - fieldStart));
+        }
+        bytes += memoryCost(column.back());
+    }
+    return bytes;
+}
+
+void TableReader::materializeColumn(int col)
+{
+    string scratch;
+    cellBytes += fillColumn(col, scratch);
+    materialized[col] = 1;
+}
+
+// returns a field without splitting out the whole column. Used to look at a few fields of a column that may not have been split out yet.
+const string& TableReader::peekCell(int col, int row, string& scratch)
+{
+    if (materialized[col])
+    {
+        return getCell(col, row);
+    }
+    const string& wholeRow = fetchRow(indexedRows[row], scratch);
+    uint32_t pos = fieldCheckpoints[row * numCheckpoints + col / indexStride];
+    if (pos == noField)
+    {
+        scratch.clear();
+        return scratch;
+    }
+    size_t fieldStart = pos;
+    for (int s = 0; s < col % indexStride; s++)
+    {
+        size_t foundPos = wholeRow.find(delim, fieldStart);
+        if (foundPos == string::npos)
+        {
+            scratch.clear();
+            return scratch;
+        }
+        fieldStart = foundPos + delim.size();
+    }
+    size_t fieldEnd = (col == numCols - 1) ? string::npos : wholeRow.find(delim, fieldStart);
+    // wholeRow may be scratch itself, so copy the field out before overwriting it
+    string field = wholeRow.substr(fieldStart, (fieldEnd == string::npos) ? string::npos : fieldEnd - fieldStart);
+    scratch.swap(field);
+    return scratch;
+}
+
+// adds an empty row to the end of rawRows for loadData() to fill in, reusing a row left over from an earlier load if there is one
+void TableReader::startRow()
+{
+    if (spareRows.empty())
+    {
+        rawRows.push_back(string());
+    }
+    else
+    {
+        rawRows.push_back(move(spareRows.back()));
+        spareRows.pop_back();
+        rawRows.back().clear();
+    }
+}
+
+// Finishes the row at the end of rawRows with the bytes from begin to end, and starts the next one.
+// If the rows read so far are over the memory budget, they are moved out to the spill file first.
+void TableReader::finishRow(const char* begin, const char* end, int endLength)
+{
+    rawRows.back().append(begin, end - begin);
+    rowEndLengths.push_back(endLength);
+    rowBytes += memoryCost(rawRows.back());
+    if (memoryBudget > 0 && rowBytes > memoryBudget)
+    {
+        spillRows();
+    }
+    startRow();
+}
+
+// In the default, strict mode, a file that isn't valid UTF-8 is an error. In the lenient modes it only gets a warning.
+void TableReader::reportEncodingError(long long byteOffset)
+{
+    if (badRowPolicy == THROW_ON_BAD_ROW)
+    {
+        dataFile.close();
+        throw EncodingError(filename, byteOffset);
+    }
+    reportWarning("File " + filename + " is not valid UTF-8. The first bad byte is at offset " + boost::lexical_cast<string>(byteOffset) + ".");
+}
+
+// adds an empty column to rawCols, reusing one left over from earlier if there is one
+void TableReader::addEmptyColumn()
+{
+    if (spareCols.empty())
+    {
+        rawCols.push_back(vector<string>());
+    }
+    else
+    {
+        rawCols.push_back(move(spareCols.back()));
+        spareCols.pop_back();
+    }
+}
+
+// empties rawCols, keeping the column vectors (and their capacity) in spareCols
+void TableReader::recycleColumns()
+{
+    for (int k = 0; k < rawCols.size(); k++)
+    {
+        rawCols[k].clear();
+        spareCols.push_back(move(rawCols[k]));
+    }
+    rawCols.clear();
+    cellBytes = 0;
+    // anything packed for export was packed from the old columns. Arrays already handed out keep their own references.
+    if (arrowExporter)
+    {
+        arrowExporter->clear();
+    }
+}
+
+// A rough count of the memory a string takes up: the string object, plus its heap buffer if it is too long to be stored inside the object.
+size_t TableReader::memoryCost(const string& item)
+{
+    const size_t inlineCapacity = 15;
+    return sizeof(string) + ((item.capacity() > inlineCapacity) ? item.capacity() + 1 : 0);
+}
+
+void TableReader::openSpillFile()
+{
+    if (! spillFile)
+    {
+        string directory = spillDirectory;
+        if (directory.empty())
+        {
+            const char* tmpDir = getenv("TMPDIR");
+            directory = (tmpDir != NULL && tmpDir[0] != '\0') ? tmpDir : "/tmp";
+        }
+        spillFile.reset(new SpillFile(directory));
+    }
+}
+
+// Moves every row held in rawRows out to the spill file as one segment. The row strings are freed rather than recycled, since the point is to give the memory back.
+void TableReader::spillRows()
+{
+    if (rawRows.empty())
+    {
+        return;
+    }
+    openSpillFile();
+    rowSegmentStarts.push_back(spilledRows);
+    rowSegments.push_back(spillFile->writeSegment(rawRows));
+    spilledRows += rawRows.size();
+    rawRows.clear();
+    rowBytes = 0;
+}
+
+// Moves every field held in rawCols out to the spill file. Each column gets its own segment, and every column is split at the same row.
+void TableReader::spillColumns()
+{
+    if (rawCols.empty() || rawCols[0].empty())
+    {
+        return;
+    }
+    openSpillFile();
+    if (colSegments.size() != rawCols.size())
+    {
+        colSegments.resize(rawCols.size());
+        pagedSegment.assign(rawCols.size(), -1);
+        pagedCells.resize(rawCols.size());
+    }
+    colSegmentStarts.push_back(spilledColRows);
+    for (int k = 0; k < rawCols.size(); k++)
+    {
+        colSegments[k].push_back(spillFile->writeSegment(rawCols[k]));
+        rawCols[k].clear();
+    }
+    spilledColRows = colSegmentStarts.back() + colSegments[0].back().numItems;
+    cellBytes = 0;
+}
+
+void TableReader::clearSpill()
+{
+    clearColumnSpill();
+    rowSegments.clear();
+    rowSegmentStarts.clear();
+    spilledRows = 0;
+    rowBytes = 0;
+    spillFile.reset();
+}
+
+void TableReader::clearColumnSpill()
+{
+    colSegments.clear();
+    colSegmentStarts.clear();
+    spilledColRows = 0;
+    pagedSegment.clear();
+    for (int k = 0; k < pagedCells.size(); k++)
+    {
+        pagedCells[k].clear();
+    }
+    for (int k = 0; k < assembledCols.size(); k++)
+    {
+        assembledCols[k].clear();
+    }
+}
+
+const string& TableReader::fetchRow(int index, string& scratch)
+{
+    if (index >= spilledRows)
+    {
+        return rawRows[index - spilledRows];
+    }
+    int segment = findSegment(rowSegmentStarts, index);
+    boost::string_ref row = spillFile->getItem(rowSegments[segment], index - rowSegmentStarts[segment]);
+    scratch.assign(row.data(), row.size());
+    return scratch;
+}
+
+// Pages the segment of the column that holds the row back into pagedCells. Only one segment per column is kept paged in,
+// and every column's segments are about the same size, so this never holds much more than the memory budget.
+const string& TableReader::pageInCell(int col, int row)
+{
+    int segment = findSegment(colSegmentStarts, row);
+    if (pagedSegment[col] != segment)
+    {
+        pagedCells[col].clear();
+        spillFile->readSegment(colSegments[col][segment], pagedCells[col]);
+        pagedSegment[col] = segment;
+    }
+    return pagedCells[col][row - colSegmentStarts[segment]];
+}
+
+void TableReader::pageInSegment(int segment, vector< vector<string> >& columns)
+{
+    columns.resize(colSegments.size());
+    for (int k = 0; k < colSegments.size(); k++)
+    {
+        columns[k].clear();
+        spillFile->readSegment(colSegments[k][segment], columns[k]);
+    }
+}
+
+// a binary search through the first rows of the segments
+int TableReader::findSegment(const vector<int>& segmentStarts, int row)
+{
+    return (upper_bound(segmentStarts.begin(), segmentStarts.end(), row) - segmentStarts.begin()) - 1;
+}
+
+// adds an entry to the bad row log
+void TableReader::logBadRow(int row, int foundFields, long long byteOffset)
+{
+    BadRow entry;
+    entry.row = row;
+    entry.expectedFields = numCols;
+    entry.foundFields = foundFields;
+    entry.byteOffset = byteOffset;
+    badRows.push_back(entry);
+}
+
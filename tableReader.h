@@ -8,24 +8,279 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <iterator>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <boost/regex.hpp>
+#include <boost/utility/string_ref.hpp>
 #include "readerExcept.h"
+#include "arrowCData.h"
 
 // forward declarations, for sanity
+class TableReader;
 class DelimFinder;
 class Delimiter;
+class SpillFile;
+class ArrowExporter;
+class RecordIterator;
 
+// what makeRawColumns() does with a row that does not have numCols fields
+enum BadRowPolicy
+{
+    THROW_ON_BAD_ROW, // throw MissingDelimError on a row with too few fields. Rows with too many fields keep the extras in the last column. This is the default.
+    PAD_BAD_ROWS, // fill in the missing fields with empty strings. Rows with too many fields keep the extras in the last column.
+    SKIP_BAD_ROWS // leave the row out of rawCols altogether
+};
+
+// whether the first row of the table holds column labels
+enum HeaderMode
+{
+    HEADER_AUTO, // guess, by comparing the type of each field in the first row with the types in the rest of the column. This is the default.
+    HEADER_PRESENT, // the first row is always a header
+    HEADER_ABSENT // the first row is always data
+};
+
+// the kind of values held in a field or a column, from narrowest to widest. detectHeader() relies on this order.
+enum ColumnType
+{
+    TYPE_EMPTY, // nothing but whitespace. Only used for single fields; fits in a column of any type.
+    TYPE_INTEGER, // an optional sign followed by digits
+    TYPE_REAL, // a decimal number, optionally with an exponent
+    TYPE_TEXT // anything else
+};
+
+// one entry in the log of bad rows kept by TableReader when it is not throwing on them
+struct BadRow
+{
+    int row; // the index of the row in rawRows
+    int expectedFields; // the number of columns in the table
+    int foundFields; // the number of fields actually in the row
+    long long byteOffset; // where the row starts in the data file
+};
+// where one run of strings lives in a SpillFile
+struct SpillSegment
+{
+    long long fileOffset; // where the segment starts in the file. Always a multiple of the page size, so the segment can be mapped on its own.
+    size_t length; // the number of bytes in the segment
+    size_t numItems; // the number of strings in the segment
+};
+
+// one column packed into the layout of an Arrow string array: every field's bytes back to back, and where each one starts.
+// Shared between the ArrowExporter that packed it and every ArrowArray exported from it, and freed when the last of them lets go.
+struct PackedColumn
+{
+    std::vector<int32_t> offsets; // numRows + 1 offsets into data. Used when the column holds less than 2 GB.
+    std::vector<int64_t> largeOffsets; // the same, for columns of 2 GB or more, which are exported as Arrow large strings
+    std::vector<char> data; // the bytes of every field
+    int64_t numRows; // the number of fields
+};
+
+// One row of the table, seen through the field index that row layout mode builds: the row's own bytes, and where each of its fields starts.
+// Nothing is copied, so a view is only good until the reader is changed.
+// A view is handed out for every row, so it is kept small and its methods are not virtual.
+class RecordView
+{
+    public:
+        static const uint32_t missingField = 0xFFFFFFFF; // how the field index marks a field that a short row doesn't have
+        RecordView(); // an empty view, with no fields
+        RecordView(const char* inData, size_t inLength, const uint32_t* inStarts, int inNumFields, size_t inDelimLength, int inRow);
+        boost::string_ref getField(int field) const; // returns one field, without the delimiter. A field missing from a padded short row is empty. Throws LayoutError if there is no such column.
+        boost::string_ref operator[](int field) const; // the same as getField()
+        std::string getFieldString(int field) const; // returns a copy of one field
+        int getNumFields() const; // returns the number of columns in the table
+        int getRow() const; // returns the index of the row in the columns, so 0 is the header, if there is one
+        boost::string_ref getText() const; // returns the whole row, as it was read
+    protected:
+        // helper functions:
+        void throwFieldError(int field) const; // throws LayoutError for a field past the last column. Kept out of line, so getField() stays small enough to inline.
+        // data members
+        const char* data; // the row's bytes
+        size_t length; // the length of the row
+        const uint32_t* starts; // where each field starts in the row. numFields entries, in the reader's field index.
+        int numFields; // the number of columns
+        size_t delimLength; // the length of the delimiter, which ends every field but the last
+        int row; // the index of the row in the columns
+};
+
+// A field ends where the next one starts, less the delimiter. The last field found in the row runs to the end of it,
+// which also gives the last column any extra fields of a long row, the same as when the columns are split.
+inline boost::string_ref RecordView::getField(int field) const
+{
+    if ((unsigned)field >= (unsigned)numFields)
+    {
+        throwFieldError(field);
+    }
+    uint32_t start = starts[field];
+    if (start == missingField)
+    {
+        return boost::string_ref();
+    }
+    size_t end = length;
+    if (field + 1 < numFields && starts[field + 1] != missingField)
+    {
+        end = starts[field + 1] - delimLength;
+    }
+    return boost::string_ref(data + start, end - start);
+}
+
+inline boost::string_ref RecordView::operator[](int field) const
+{
+    return getField(field);
+}
+
+// steps through the rows of a TableReader in row layout mode, one RecordView at a time.
+// The view it points at changes as it moves, so copy out any fields that are needed for longer.
+class RecordIterator
+{
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef RecordView value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const RecordView* pointer;
+        typedef const RecordView& reference;
+        RecordIterator(); // an iterator that belongs to no reader
+        RecordIterator(TableReader* inReader, int inRow); // an iterator at the given row of the reader's columns
+        virtual ~RecordIterator();
+        const RecordView& operator*(); // returns the view of the current row, reading the row first if it hasn't been
+        const RecordView* operator->();
+        RecordIterator& operator++(); // moves on to the next row
+        RecordIterator operator++(int);
+        bool operator==(const RecordIterator& other) const;
+        bool operator!=(const RecordIterator& other) const;
+        int getRow() const; // returns the index of the current row in the columns
+    protected:
+        TableReader* reader; // the reader being stepped through
+        int row; // the current row
+        int viewRow; // the row that view holds, or -1 if it holds none yet
+        RecordView view; // the view of the current row
+};
+
+// What one load of a feed learned about its layout: the delimiter, the number of columns, whether there is a header row,
+// and the type of each column. Saved from one load, it can be given to later loads of the same feed, which then skip
+// guessing the delimiter and inferring the types.
+class SchemaProfile
+{
+    public:
+        SchemaProfile();
+        virtual ~SchemaProfile();
+        virtual void save(const std::string& fileName); // writes the profile to a text file. Can throw FileOpenError and FileWriteError.
+        virtual void load(const std::string& fileName); // reads a profile written by save(). Can throw FileOpenError, FileReadError, and PatternError if its pattern isn't a valid regular expression.
+        virtual void setName(const std::string& inName); // sets a name for the profile, such as the name of the feed
+        virtual void setFilenamePattern(const std::string& inPattern); // sets a regular expression. Files whose names contain a match are matched to this profile. Throws PatternError if it isn't a valid regular expression.
+        virtual bool matchesFilename(const std::string& fileName); // returns whether the file name contains a match for the pattern. Always false if there is no pattern.
+        virtual bool matchesHeader(const std::string& firstRow); // returns whether a file's first row is exactly this profile's header row. Always false if the profile has no header row.
+        // "get" methods:
+        virtual std::string getName(); // returns the value of name
+        virtual std::string getFilenamePattern(); // returns the value of filenamePattern
+        virtual std::string getDelim(); // returns the value of delim
+        virtual int getNumCols(); // returns the value of numCols
+        virtual bool hasHeaderRow(); // returns the value of hasHeader
+        virtual std::string getHeaderLine(); // returns the value of headerLine
+        virtual std::vector<ColumnType> getColTypes(); // returns the value of colTypes
+        virtual bool isEmpty(); // returns whether the profile has never been filled in
+    friend class TableReader;
+    protected:
+        // data members
+        std::string name; // what the profile is called. Only used in messages.
+        std::string filenamePattern; // a regular expression for the names of files that this profile applies to. Empty if the profile is only matched by its header.
+        boost::regex filenameRegex; // filenamePattern, compiled when it is set
+        std::string delim; // the delimiter
+        int numCols; // the number of columns. 0 if the profile is empty.
+        bool hasHeader; // whether the first row holds column labels
+        std::string headerLine; // the first row of the file, exactly as it was read, if it is a header. Acts as a fingerprint of the feed.
+        std::vector<ColumnType> colTypes; // the type of each column
+};
+
+// What a TableReader has been told to do: everything set through its "set" methods. Moved as a whole when a reader is moved,
+// and the reader moved from goes back to the defaults.
+struct ReaderSettings
+{
+    ReaderSettings(); // the default settings
+    bool autoDelim; // whether or not to use determineDelim(). defaults to true
+    std::string delim; // the delimiter used for separating columns, can be set by setDelim() or by determineDelim().
+    BadRowPolicy badRowPolicy; // what to do with rows that have the wrong number of fields. defaults to THROW_ON_BAD_ROW
+    HeaderMode headerMode; // how to decide whether the first row is a header. defaults to HEADER_AUTO
+    size_t memoryBudget; // how much memory rows and fields may take up before they are spilled. 0 means no limit.
+    std::string spillDirectory; // where the spill file is created. Empty means $TMPDIR, or /tmp.
+    bool lazyColumns; // whether to put off splitting each column until it is used. defaults to false
+    bool rowLayout; // whether makeRawColumns() records where every field starts, rather than splitting the columns. defaults to false
+    bool validateUtf8; // whether loadData() checks the encoding of the file. defaults to true
+    std::vector<SchemaProfile> profiles; // the profiles makeRawColumns() may use. If useSchemaProfile() was called, its profile is the first one.
+    bool hasSuppliedProfile; // whether profiles[0] came from useSchemaProfile(), and so is tried whatever the file is called
+};
 
-class TableReader
+// Everything a TableReader has loaded or worked out from a file, and the buffers it keeps for later loads. Moved as a whole when a reader
+// is moved, so a member added here is moved along with the rest.
+struct ReaderData
+{
+    ReaderData(); // an empty reader's data
+    std::ifstream dataFile; // the file stream object used to load in the data from the text file
+    std::string filename; // the name of the file containing the data to be loaded
+    std::vector<std::string> rawRows; // each element is one line from the data file, or a single row of unprocessed data
+    std::vector< vector<string> > rawCols; // the columns of data, as strings. Includes column labels, if there are any.
+    int numCols;
+    int finderCode; // holds the return value of DelimFinder::guessDelim.
+    std::vector<BadRow> badRows; // the log of rows that had the wrong number of fields
+    std::vector<std::string> warnings; // messages from guessing the delimiter, such as not finding one
+    bool hasHeader; // whether the first row holds column labels
+    std::vector<ColumnType> colTypes; // the type of the data in each column, inferred from a sample of the rows below the header
+    std::unordered_map<std::string, int> colIndex; // maps each column label to the index of its column
+    std::vector<std::string> spareRows; // emptied row strings from earlier loads, reused by loadData()
+    std::vector< vector<string> > spareCols; // emptied column vectors from earlier loads, reused by makeRawColumns()
+    size_t rowBytes; // roughly how much memory the rows in rawRows take up
+    size_t cellBytes; // roughly how much memory the fields in rawCols take up
+    std::unique_ptr<SpillFile> spillFile; // the temporary file that rows and fields are moved out to
+    int spilledRows; // how many rows at the start of the table have moved out of rawRows. rawRows[0] is row spilledRows.
+    std::vector<SpillSegment> rowSegments; // where the spilled rows are in spillFile
+    std::vector<int> rowSegmentStarts; // the first row in each of rowSegments
+    int spilledColRows; // how many rows at the top of rawCols have moved out. rawCols[k][0] is row spilledColRows of column k.
+    std::vector< std::vector<SpillSegment> > colSegments; // colSegments[k][s] is segment s of column k. Every column is split at the same rows.
+    std::vector<int> colSegmentStarts; // the first row in each column segment
+    std::vector<int> pagedSegment; // for each column, which of its segments is in pagedCells. -1 if none.
+    std::vector< std::vector<std::string> > pagedCells; // for each column, the spilled segment most recently paged back in by getCell()
+    std::vector< std::vector<std::string> > assembledCols; // for each column, the whole column, if it has spilled and getColumn() has put it back together. Empty otherwise.
+    int indexStride; // the start of every indexStride'th field of a row is recorded in the field index: every eighth in lazy mode, every one in row layout mode
+    int numCheckpoints; // how many field starts are recorded for each row in the field index
+    std::vector<uint32_t> fieldCheckpoints; // for each indexed row, where every indexStride'th field starts in the row. Fields a short row doesn't have are marked RecordView::missingField. In row layout mode, each row's numCols entries are its field offsets.
+    std::vector<int> indexedRows; // the row in rawRows behind each row of the columns, in lazy mode. Only differs from the row number if rows were skipped.
+    int numIndexedRows; // how many rows are in the lazy field index
+    std::vector<char> materialized; // for each column, whether it has been split out of the rows yet
+    std::vector<unsigned char> rowEndLengths; // how many bytes of line ending followed each row in the file: 1 for LF or CR, 2 for CRLF, 0 for an unterminated last row
+    long long dataStartOffset; // where the first row starts in the file: 3 if there was a byte order mark, otherwise 0
+    std::vector<char> readBuffer; // the block of the file being scanned by loadData(). Kept between loads, until releaseBuffers().
+    int profileInUse; // the index in profiles of the profile used by the last makeRawColumns(), or -1
+    std::unique_ptr<ArrowExporter> arrowExporter; // packs columns for exportArrow(), and keeps them so that later exports share the same buffers
+};
+
+class TableReader : protected ReaderSettings, protected ReaderData
 {
     public:
         TableReader(); // need to make another version thar takes arguments
+        TableReader(TableReader&& other) noexcept; // takes over other's settings, data and buffers without copying them. other is left with the default settings, as if reset() had been called.
+        TableReader& operator=(TableReader&& other) noexcept; // the same, for an existing reader. This reader's own settings, data and buffers are freed.
         virtual ~TableReader(); // should check if dataFile.is_open() is true. If it is, close the file.
         virtual void setDelim(const std::string& inDelim); // sets the character(s) used as the delimiter in the file. Also sets autoDelim to false, so that the user's decision does not get overridden.
         virtual void setDelim(const char inDelim); // sets the character(s) used as the delimiter in the file. Also sets autoDelim to false, so that the user's decision does not get overridden.
         virtual void unsetDelim();
-        virtual void loadData(std::string fileName); // reads the data from the file and puts it into rawRows. Checks whether the dataFile is open first. There should be a constructor that does this automatically. This cannot be the final step, as you need to give the user ample time to call setDelim() if they want.
-        virtual void makeRawColumns();
+        virtual void loadData(std::string fileName); // reads the data from the file and puts it into rawRows, checking that it is valid UTF-8 and dropping line endings (LF, CRLF or CR) and any byte order mark. Checks whether the dataFile is open first. There should be a constructor that does this automatically. This cannot be the final step, as you need to give the user ample time to call setDelim() if they want.
+        virtual void makeRawColumns(); // splits rawRows into rawCols. Any columns made before are replaced. Throws SettingsError if lazy mode and a memory budget are both set.
+        virtual void reset(); // forgets the loaded data so another file can be loaded, keeping the settings and the allocated buffers
+        virtual void reload(std::string fileName); // reset(), then loadData()
+        virtual void releaseBuffers(); // frees the buffers kept by reset()
+        virtual void setMemoryBudget(size_t inBytes); // sets roughly how much memory rows and fields may take up before they are moved out to a temporary file. 0, the default, means no limit.
+        virtual void setSpillDirectory(const std::string& inDirectory); // sets where the temporary file goes. Defaults to $TMPDIR, or /tmp.
+        virtual void setValidateUtf8(bool inValidate); // sets whether loadData() checks that the file is valid UTF-8. Defaults to true.
+        virtual void setLazyColumns(bool inLazy); // in lazy mode, makeRawColumns() only indexes the rows, and each column is split out the first time it is used. Can't be used with a memory budget. Defaults to false.
+        virtual void materializeColumns(const std::vector<int>& cols); // splits out the listed columns now, in parallel if there are several
+        virtual void materializeAllColumns(); // splits out every column that hasn't been yet
+        virtual void setRowLayout(bool inRowLayout); // in row layout mode, makeRawColumns() records where every field of every row starts, for getRecord() and beginRecords(), and leaves the columns to be split out on first use, as in lazy mode. Can't be used with a memory budget, or on rows that were spilled while loading. Defaults to false.
+        virtual void setHeaderMode(HeaderMode inMode); // sets how makeRawColumns() decides whether the first row is a header
+        virtual void useSchemaProfile(const SchemaProfile& inProfile); // makes makeRawColumns() try this profile first, whatever the file is called
+        virtual void addSchemaProfile(const SchemaProfile& inProfile); // adds a profile that makeRawColumns() uses for any file matching its filename pattern or its header row
+        virtual void clearSchemaProfiles(); // forgets every profile given to useSchemaProfile() or addSchemaProfile()
+        virtual void setBadRowPolicy(BadRowPolicy inPolicy); // sets what makeRawColumns() does with rows that have the wrong number of fields. With anything but THROW_ON_BAD_ROW, those rows are recorded in the bad row log instead.
         // "get" methods:
         virtual std::string getDelim(); // returns the value of delim. lets you check what delimiter you're using.
         virtual std::string getFilename(); // returns the filename you're using
@@ -33,21 +288,72 @@ class TableReader
         virtual int getNumRawRows(); // returns the number of raw rows
         virtual string getDelimFinderInfo(); // returns finderCode, as well as what it means
         virtual int getNumCols(); // returns the number of columns in the data (held in numCols)
+        virtual int getNumRows(); // returns the number of rows in rawCols, including any that have been spilled
+        virtual size_t getMemoryBudget(); // returns the value of memoryBudget
+        virtual size_t getMemoryInUse(); // returns roughly how much memory the rows and fields held in memory take up
+        virtual bool hasSpilled(); // returns whether any rows or fields have been moved out to the temporary file
+        virtual bool getLazyColumns(); // returns the value of lazyColumns
+        virtual bool getRowLayout(); // returns the value of rowLayout
+        virtual bool getValidateUtf8(); // returns the value of validateUtf8
+        virtual bool isMaterialized(int col); // returns whether a column has been split out of the rows yet
         virtual vector< vector<string> > getRawCols();
+        virtual BadRowPolicy getBadRowPolicy(); // returns the value of badRowPolicy
+        virtual vector<BadRow> getBadRows(); // returns the log of rows that had the wrong number of fields
+        virtual int getNumBadRows(); // returns the number of entries in the bad row log
+        virtual vector<string> getWarnings(); // returns any warnings raised while guessing the delimiter, checking the encoding or trying schema profiles
+        virtual bool hasHeaderRow(); // returns whether the first row was taken to be column labels
+        virtual int getFirstDataRow(); // returns the index in rawCols of the first row of data: 1 if there is a header row, 0 if not
+        virtual vector<string> getColNames(); // returns the column labels, or an empty vector if there is no header row
+        virtual SchemaProfile getSchemaProfile(); // returns a profile of the table as loaded, for saving and giving to later loads. Call after makeRawColumns(). Throws NoDelimsError if the table has no delimiter.
+        virtual bool usedSchemaProfile(); // returns whether makeRawColumns() took the layout from a profile, rather than working it out
+        virtual std::string getProfileName(); // returns the name of the profile makeRawColumns() used, or an empty string
+        virtual int getColIndex(const std::string& name); // returns the index of the column with the given label. Throws ColumnError if there is no such column.
+        virtual bool hasColumn(const std::string& name); // returns whether a column has the given label
+        virtual ColumnType getColType(int col); // returns the type inferred for the data in a column
+        virtual const vector<string>& getColumn(int col); // returns one column of rawCols without copying it. Includes the label, if there is one. The reference is good until the reader is reset, reloaded, or makes its columns again. If the table has spilled, the column is put back together in assembledCols the first time, and stays in memory until then.
+        virtual const vector<string>& getColumn(const std::string& name);
+        virtual const string& getCell(int col, int row); // returns rawCols[col][row] without copying it. Throws ColumnError if there is no such cell. If the row has spilled, its segment of the column is paged back in, and the reference is good until another segment of that column is.
+        virtual const string& getCell(const std::string& name, int row);
+        virtual vector< vector<string> > projectColumns(const vector<string>& names); // returns just the named columns, in the order named, laid out like rawCols
+        virtual vector<int> filterRows(const std::string& name, std::function<bool (const std::string&)> keep); // returns the indices of the data rows whose field in the named column passes keep()
+        virtual RecordView getRecord(int row); // returns a view of one row of the columns, header row included. Only in row layout mode; throws LayoutError otherwise, or if there is no such row.
+        virtual RecordIterator beginRecords(); // returns an iterator at the first row of data. Only in row layout mode; throws LayoutError otherwise.
+        virtual RecordIterator endRecords(); // returns an iterator just past the last row
+        virtual void exportArrow(ArrowSchema* outSchema, ArrowArray* outArray); // hands the data rows of every column to an Arrow consumer, as a struct array with one string child per column. The consumer must call the release callbacks.
+        virtual void exportArrow(const std::vector<int>& cols, ArrowSchema* outSchema, ArrowArray* outArray); // the same, for just the listed columns
     friend class DelimFinder;
+    friend class TableWriter;
     protected:
         // helper functions:
        // virtual void determineDelim(); // guesses the delimiter based on a reading of the data from the file
-        // data members
-        std::ifstream dataFile; // the file stream object used to load in the data from the text file
-        std::string filename; // the name of the file containing the data to be loaded
-        bool autoDelim; // whether or not to use determineDelim(). defaults to true
-        std::string delim; // the delimiter used for separating columns, can be set by setDelim() or by determineDelim().
-        std::vector<std::string> rawRows; // each element is one line from the data file, or a single row of unprocessed data
-        std::vector< vector<string> > rawCols; // the columns of data, as strings. Includes column labels, if there are any.
-        int numCols;
-        int finderCode; // holds the return value of DelimFinder::guessDelim.
-
+        virtual void reportWarning(const std::string& message); // adds a message to warnings, for getWarnings(). Nothing is printed.
+        virtual void logBadRow(int row, int foundFields, long long byteOffset); // adds an entry to badRows
+        virtual int findSchemaProfile(); // returns the index in profiles of the first profile that applies to the loaded file and passes checkProfile(), or -1
+        virtual bool checkProfile(const SchemaProfile& profile); // checks a profile against the first rows of the file: the field count, the header row, and the type of each field
+        virtual void applyProfileHeader(const SchemaProfile& profile); // sets hasHeader, colTypes and colIndex from a profile, in place of detectHeader()
+        virtual void detectHeader(); // decides whether the first row is a header, fills in colTypes, and builds colIndex
+        virtual ColumnType classifyCell(const std::string& cell); // works out whether a single field is empty, an integer, a real number or text
+        virtual void addEmptyColumn(); // adds an empty column to rawCols, taking it from spareCols if possible
+        virtual void recycleColumns(); // empties rawCols into spareCols, and clears the columns packed for export
+        virtual size_t memoryCost(const std::string& item); // roughly how much memory a string takes up, including the string object itself
+        virtual void openSpillFile(); // creates spillFile, if it doesn't exist yet
+        virtual void spillRows(); // moves every row in rawRows out to the spill file
+        virtual void spillColumns(); // moves every field in rawCols out to the spill file, as one segment per column
+        virtual void clearSpill(); // forgets everything that has been spilled, and closes the spill file
+        virtual void clearColumnSpill(); // forgets the spilled column segments, but not the spilled rows
+        virtual const std::string& fetchRow(int index, std::string& scratch); // returns a row without copying it if it is in memory. Spilled rows are copied into scratch.
+        virtual const std::string& pageInCell(int col, int row); // used by getCell() for fields that have been spilled
+        virtual void pageInSegment(int segment, std::vector< std::vector<std::string> >& columns); // reads one spilled segment of every column back into columns
+        virtual int findSegment(const std::vector<int>& segmentStarts, int row); // returns which segment holds a row
+        virtual bool findFields(const std::string& row, int rownum, long long rowOffset, std::vector<size_t>& fieldEnds, int& lastField); // finds the delimiters in a row and applies badRowPolicy. Returns false if the row should be left out.
+        virtual void startFieldIndex(); // clears the lazy field index, and marks which columns are split out
+        virtual void indexRow(int rownum, int lastField, const std::vector<size_t>& fieldEnds); // adds a row to the lazy field index
+        virtual size_t fillColumn(int col, std::string& scratch); // splits one column out of the rows using the field index. Safe to run on several columns at once if no rows have spilled.
+        virtual void materializeColumn(int col); // splits out one column and marks it as done
+        virtual void startRow(); // adds an empty row to rawRows for loadData() to fill in, taking it from spareRows if possible
+        virtual void finishRow(const char* begin, const char* end, int endLength); // adds bytes to the last row, records its line ending, and starts the next row
+        virtual void reportEncodingError(long long byteOffset); // throws EncodingError, or just warns in the lenient modes
+        virtual const std::string& peekCell(int col, int row, std::string& scratch); // returns one field without splitting out its whole column. The field may be put in scratch.
 };
 
 // the following class should only every be called in the context of an existing TableReader object
@@ -61,7 +367,7 @@ class DelimFinder
     protected:
         // helper functions:
         virtual void findPossibleDelims(); // goes through the last row of the raw text data and pulls out all the nonletter, nonnumber characters. Counts the occurrences of each.
-        virtual void countDelimOccurrences(); // goes through the rest of the data set and counts how many times each possible delim (each character in lastRowCharas) occurs.
+        virtual bool countDelimOccurrences(); // goes through the rest of the data set and counts how many times each possible delim (each character in lastRowCharas) occurs. Returns false if there were no possible delims to count.
         virtual tuple<bool, int> searchDelims(char inChar); // searches through delimList to see if inChar has already been listed. Returns bool and a position.
         // data members
         std::vector<Delimiter> delimList; // each element is a nonletter, nonnumber character in the last row. There are no repeats. Items are removed from the list if they do not occur the same number of times in each row.
@@ -71,6 +377,67 @@ class DelimFinder
 
 };
 
+// a temporary file holding rows and fields that TableReader has moved out of memory.
+// The file is deleted as soon as it is created, so it goes away when it is closed, even if the program crashes.
+class SpillFile
+{
+    public:
+        SpillFile(const std::string& inDirectory); // creates the temporary file in the given directory. Throws FileOpenError if it can't.
+        virtual ~SpillFile(); // unmaps the file and closes it
+        virtual SpillSegment writeSegment(const std::vector<std::string>& items); // copies every string in items to the end of the file. Throws FileWriteError if that fails.
+        virtual boost::string_ref getItem(const SpillSegment& segment, size_t index); // returns one string from a segment. Good until a different segment is accessed.
+        virtual void readSegment(const SpillSegment& segment, std::vector<std::string>& out); // appends every string in a segment to out
+        virtual long long getSize(); // returns the size of the file in bytes
+    protected:
+        // helper functions:
+        virtual const char* mapSegment(const SpillSegment& segment); // maps a segment into memory, unmapping whatever segment was mapped before
+        virtual void writeBytes(const char* data, size_t length); // adds bytes to the end of the file, through writeBuffer
+        virtual void flushWriteBuffer();
+        // data members
+        std::string path; // where the file was created
+        int fileDesc; // the file descriptor of the open file
+        long long fileSize; // how many bytes have been written to the file
+        long long mappedOffset; // the file offset of the segment that is currently mapped, or -1
+        char* mappedBase; // where the currently mapped segment starts in memory
+        size_t mappedLength; // the length of the current mapping
+        std::string writeBuffer; // bytes waiting to be written to the file
+};
+
+// packs TableReader columns into Arrow string arrays, and hands them out through the Arrow C Data Interface.
+// Each column is packed once; every array exported from it after that shares the packed buffers instead of copying them.
+class ArrowExporter
+{
+    public:
+        ArrowExporter();
+        virtual ~ArrowExporter(); // arrays already exported keep their buffers until they are released
+        virtual void exportColumns(TableReader& reader, const std::vector<int>& cols, ArrowSchema* outSchema, ArrowArray* outArray); // fills in outSchema and outArray with a struct array of the listed columns
+        virtual void clear(); // lets go of every packed column, for when the reader's data changes
+        virtual int getNumPacked(); // returns the number of columns packed so far
+    protected:
+        // helper functions:
+        virtual std::shared_ptr<PackedColumn> packColumn(TableReader& reader, int col); // returns the packed column, packing it first if it hasn't been
+        // data members
+        std::vector< std::shared_ptr<PackedColumn> > packed; // the packed columns, by column index. Empty where a column hasn't been packed yet.
+};
+
+// checks that a stream of bytes is valid UTF-8, one block at a time. Blocks can end in the middle of a character.
+class Utf8Validator
+{
+    public:
+        Utf8Validator();
+        virtual ~Utf8Validator();
+        virtual bool validate(const char* data, size_t length, long long streamOffset); // checks the next block, which starts at streamOffset in the stream. Returns false at the first invalid byte.
+        virtual bool finish(long long streamOffset); // call at the end of the stream. Returns false if it ended partway through a character.
+        virtual bool inCharacter(); // returns whether the last block ended partway through a character
+        virtual long long getErrorOffset(); // returns where in the stream the first invalid byte was, or -1
+        virtual void reset(); // gets ready to check a new stream
+    protected:
+        int bytesNeeded; // how many more continuation bytes the current character needs
+        unsigned char lowerBound; // the smallest value the next continuation byte may have
+        unsigned char upperBound; // the largest value the next continuation byte may have
+        long long errorOffset; // where the first invalid byte was
+};
+
 class Delimiter
 {
     public:
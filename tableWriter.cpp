@@ -0,0 +1,456 @@
+#include "tableWriter.h"
+#include "tableReader.h"
+#include "joinGuard.h"
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// implementation for TableWriter class
+
+using namespace std;
+
+// how many rows each formatting thread takes at a time in writeColumns()
+static const size_t rowsPerChunk = 8192;
+
+// what writeColumns() and its formatting threads share. Each thread has one buffer, which it fills with a chunk of rows and marks ready;
+// writeColumns() writes the ready buffers out in chunk order, and hands each one back by clearing its mark.
+struct ChunkHandoff
+{
+    mutex lock;
+    condition_variable changed;
+    vector<char> ready; // for each thread, whether its buffer holds a chunk that hasn't been written out yet
+    bool stopping; // set when writeColumns() gives up early, so that the threads stop waiting for their buffers
+};
+
+// writes the decimal digits of value into the end of digits, and returns a pointer to the first one.
+// digits needs room for at least 20 characters. Much faster than going through a stream or lexical_cast.
+static char* formatInteger(long long value, char* digitsEnd)
+{
+    // work with the magnitude as unsigned, so that the most negative value doesn't overflow
+    unsigned long long magnitude = (value < 0) ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    char* pos = digitsEnd;
+    do
+    {
+        *--pos = (char)('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0)
+    {
+        *--pos = '-';
+    }
+    return pos;
+}
+
+// default constructor
+TableWriter::TableWriter() : filename("NO_FILE"), autoDelim(true), delim(","), quoteChar('\"'), quoteMode(QUOTE_MINIMAL), bufferSize(1 << 20), numThreads(1), rowStarted(false), rowsWritten(0)
+{
+    // the stream doesn't need a buffer of its own. Everything is collected in buffer, and handed over in large blocks.
+    outFile.rdbuf()->pubsetbuf(0, 0);
+}
+
+// destructor
+TableWriter::~TableWriter()
+{
+    // destructors can't throw, so a failed final flush is dropped here. Call close() yourself if you need to know about it.
+    try
+    {
+        close();
+    }
+    catch (FileError&)
+    {
+    }
+}
+
+// sets the delimiter to whatever string the user thinks appropriate. Can be multiple characters in length.
+void TableWriter::setDelim(const string& inDelim)
+{
+    delim = inDelim;
+    autoDelim = false;
+}
+
+void TableWriter::setDelim(const char inDelim)
+{
+    delim = string(1, inDelim);
+    autoDelim = false;
+}
+
+// lets you undo the actions of setDelim().
+void TableWriter::unsetDelim()
+{
+    delim = ",";
+    autoDelim = true;
+}
+
+void TableWriter::setQuoteChar(const char inQuote)
+{
+    quoteChar = inQuote;
+}
+
+void TableWriter::setQuoteMode(QuoteMode inMode)
+{
+    quoteMode = inMode;
+}
+
+void TableWriter::setBufferSize(size_t inBytes)
+{
+    bufferSize = (inBytes > 0) ? inBytes : 1;
+}
+
+void TableWriter::setNumThreads(int inThreads)
+{
+    numThreads = (inThreads > 0) ? inThreads : 1;
+}
+
+string TableWriter::getDelim()
+{
+    return delim;
+}
+
+string TableWriter::getFilename()
+{
+    return filename;
+}
+
+long TableWriter::getNumRowsWritten()
+{
+    return rowsWritten;
+}
+
+void TableWriter::open(string inFilename)
+{
+    // finish off whatever file was open before
+    close();
+    filename = inFilename;
+    outFile.open(inFilename.c_str(), ios::out | ios::trunc | ios::binary);
+    if (! outFile.is_open())
+    {
+        throw FileOpenError(filename);
+    }
+    rowsWritten = 0;
+    rowStarted = false;
+    buffer.reserve(bufferSize + (bufferSize / 4));
+}
+
+void TableWriter::close()
+{
+    if (outFile.is_open())
+    {
+        if (rowStarted)
+        {
+            endRow();
+        }
+        flush();
+        outFile.close();
+    }
+}
+
+void TableWriter::flush()
+{
+    if (buffer.empty())
+    {
+        return;
+    }
+    outFile.write(buffer.data(), buffer.size());
+    if (! outFile.good())
+    {
+        throw FileWriteError(filename);
+    }
+    buffer.clear(); // keeps the capacity, so the next batch of rows doesn't have to grow it again
+}
+
+// writes the columns of a TableReader, using the reader's delimiter unless one has been set with setDelim()
+void TableWriter::writeTable(TableReader& reader)
+{
+    if (autoDelim)
+    {
+        delim = (reader.delim == "NO_DELIMITER") ? "," : reader.delim;
+    }
+    // rows that have been spilled are read back one segment at a time, so the writer never needs much more memory than the reader's budget
+    reader.materializeAllColumns();
+    vector< vector<string> > segmentCols;
+    for (int segment = 0; segment < reader.colSegmentStarts.size(); segment++)
+    {
+        reader.pageInSegment(segment, segmentCols);
+        writeColumns(segmentCols);
+    }
+    writeColumns(reader.rawCols);
+}
+
+void TableWriter::writeColumns(const vector< vector<string> >& columns)
+{
+    if (rowStarted)
+    {
+        endRow();
+    }
+    // the longest column decides how many rows there are. Shorter columns get empty fields at the bottom.
+    size_t numRows = 0;
+    for (size_t k = 0; k < columns.size(); k++)
+    {
+        if (columns[k].size() > numRows)
+        {
+            numRows = columns[k].size();
+        }
+    }
+    if (columns.empty() || numRows == 0)
+    {
+        return;
+    }
+
+    if (numThreads <= 1 || numRows <= rowsPerChunk)
+    {
+        for (size_t first = 0; first < numRows; first += rowsPerChunk)
+        {
+            size_t last = (first + rowsPerChunk < numRows) ? first + rowsPerChunk : numRows;
+            formatRows(columns, first, last, buffer);
+            flushIfFull();
+        }
+    }
+    else
+    {
+        // The threads are started once. Thread t formats chunks t, t + numThreads, and so on, each into its own buffer, and the buffers
+        // are written out in chunk order, so the file comes out exactly as it would with one thread. A thread only starts on its next
+        // chunk once its last one has been written, so no more than numThreads chunks are held at a time.
+        size_t numChunks = (numRows + rowsPerChunk - 1) / rowsPerChunk;
+        int usedThreads = ((size_t)numThreads < numChunks) ? numThreads : (int)numChunks;
+        if (chunkBuffers.size() < (size_t)usedThreads)
+        {
+            chunkBuffers.resize(usedThreads);
+        }
+        flush();
+        ChunkHandoff handoff;
+        handoff.ready.assign(usedThreads, 0);
+        handoff.stopping = false;
+        // however this is left, the threads are told to stop before they are joined, so none is left waiting for its buffer
+        vector<thread> workers;
+        JoinGuard guard(workers, [&handoff]()
+        {
+            {
+                lock_guard<mutex> held(handoff.lock);
+                handoff.stopping = true;
+            }
+            handoff.changed.notify_all();
+        });
+        for (int t = 0; t < usedThreads; t++)
+        {
+            workers.push_back(thread([this, &columns, &handoff, numRows, numChunks, usedThreads, t]()
+            {
+                for (size_t chunk = t; chunk < numChunks; chunk += usedThreads)
+                {
+                    {
+                        unique_lock<mutex> held(handoff.lock);
+                        handoff.changed.wait(held, [&handoff, t]() { return ! handoff.ready[t] || handoff.stopping; });
+                        if (handoff.stopping)
+                        {
+                            return;
+                        }
+                    }
+                    size_t first = chunk * rowsPerChunk;
+                    size_t last = (first + rowsPerChunk < numRows) ? first + rowsPerChunk : numRows;
+                    chunkBuffers[t].clear();
+                    formatRows(columns, first, last, chunkBuffers[t]);
+                    {
+                        lock_guard<mutex> held(handoff.lock);
+                        handoff.ready[t] = 1;
+                    }
+                    handoff.changed.notify_all();
+                }
+            }));
+        }
+        for (size_t chunk = 0; chunk < numChunks; chunk++)
+        {
+            int t = chunk % usedThreads;
+            {
+                unique_lock<mutex> held(handoff.lock);
+                handoff.changed.wait(held, [&handoff, t]() { return handoff.ready[t] != 0; });
+            }
+            outFile.write(chunkBuffers[t].data(), chunkBuffers[t].size());
+            if (! outFile.good())
+            {
+                throw FileWriteError(filename);
+            }
+            {
+                lock_guard<mutex> held(handoff.lock);
+                handoff.ready[t] = 0;
+            }
+            handoff.changed.notify_all();
+        }
+    }
+    rowsWritten += numRows;
+}
+
+void TableWriter::writeRow(const vector<string>& fields)
+{
+    if (rowStarted)
+    {
+        endRow();
+    }
+    for (size_t k = 0; k < fields.size(); k++)
+    {
+        if (k > 0)
+        {
+            buffer += delim;
+        }
+        appendEscaped(buffer, fields[k].data(), fields[k].size());
+    }
+    buffer += '\n';
+    rowsWritten++;
+    flushIfFull();
+}
+
+void TableWriter::appendField(const string& field)
+{
+    startField();
+    appendEscaped(buffer, field.data(), field.size());
+}
+
+void TableWriter::appendField(int value)
+{
+    appendField((long long)value);
+}
+
+void TableWriter::appendField(long value)
+{
+    appendField((long long)value);
+}
+
+void TableWriter::appendField(long long value)
+{
+    startField();
+    char digits[24];
+    char* digitsEnd = digits + sizeof(digits);
+    char* first = formatInteger(value, digitsEnd);
+    // numbers never contain quotes or line breaks, so they only need quoting if the delimiter is a digit or a minus sign
+    appendEscaped(buffer, first, digitsEnd - first);
+}
+
+void TableWriter::appendField(double value)
+{
+    startField();
+    char digits[32];
+    // whole numbers are common in real tables, and are much cheaper to format as integers
+    if (value == value && value > -1e15 && value < 1e15 && value == (double)(long long)value)
+    {
+        char* digitsEnd = digits + sizeof(digits);
+        char* first = formatInteger((long long)value, digitsEnd);
+        appendEscaped(buffer, first, digitsEnd - first);
+        return;
+    }
+    // Use the fewest significant digits that read back as exactly the same value, so that 0.1 is written as 0.1.
+    // 17 digits are always enough, but most values need no more than 15.
+    int length = 0;
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        length = snprintf(digits, sizeof(digits), "%.*g", precision, value);
+        if (precision == 17 || strtod(digits, NULL) == value)
+        {
+            break;
+        }
+    }
+    appendEscaped(buffer, digits, length);
+}
+
+void TableWriter::endRow()
+{
+    buffer += '\n';
+    rowStarted = false;
+    rowsWritten++;
+    flushIfFull();
+}
+
+// here are the protected helper functions
+
+void TableWriter::formatRows(const vector< vector<string> >& columns, size_t firstRow, size_t lastRow, string& out)
+{
+    // this runs on several threads at once in writeColumns(), so it must only read the writer's settings, never change them
+    for (size_t row = firstRow; row < lastRow; row++)
+    {
+        for (size_t k = 0; k < columns.size(); k++)
+        {
+            if (k > 0)
+            {
+                out += delim;
+            }
+            if (row < columns[k].size())
+            {
+                appendEscaped(out, columns[k][row].data(), columns[k][row].size());
+            }
+            else if (quoteMode == QUOTE_ALL)
+            {
+                appendEscaped(out, "", 0);
+            }
+        }
+        out += '\n';
+    }
+}
+
+void TableWriter::appendEscaped(string& out, const char* field, size_t length)
+{
+    if (quoteMode == QUOTE_NONE || (quoteMode == QUOTE_MINIMAL && ! needsQuotes(field, length)))
+    {
+        out.append(field, length);
+        return;
+    }
+    // quote the field, doubling every quote character inside it
+    out += quoteChar;
+    const char* pos = field;
+    const char* end = field + length;
+    while (pos < end)
+    {
+        const char* nextQuote = (const char*)memchr(pos, quoteChar, end - pos);
+        if (nextQuote == NULL)
+        {
+            out.append(pos, end - pos);
+            break;
+        }
+        out.append(pos, nextQuote - pos + 1);
+        out += quoteChar;
+        pos = nextQuote + 1;
+    }
+    out += quoteChar;
+}
+
+bool TableWriter::needsQuotes(const char* field, size_t length)
+{
+    if (delim.size() == 1)
+    {
+        char delimChar = delim[0];
+        for (size_t i = 0; i < length; i++)
+        {
+            char c = field[i];
+            if (c == delimChar || c == quoteChar || c == '\n' || c == '\r')
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = field[i];
+        if (c == quoteChar || c == '\n' || c == '\r')
+        {
+            return true;
+        }
+    }
+    return (! delim.empty() && search(field, field + length, delim.begin(), delim.end()) != field + length);
+}
+
+void TableWriter::startField()
+{
+    if (rowStarted)
+    {
+        buffer += delim;
+    }
+    rowStarted = true;
+}
+
+void TableWriter::flushIfFull()
+{
+    if (buffer.size() >= bufferSize)
+    {
+        flush();
+    }
+}
@@ -0,0 +1,74 @@
+// header file for TableWriter class
+#ifndef _TABLE_WRITER_
+#define _TABLE_WRITER_
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "readerExcept.h"
+
+// forward declarations, for sanity
+class TableReader;
+
+// when to wrap a field in quote characters
+enum QuoteMode
+{
+    QUOTE_MINIMAL, // only fields containing the delimiter, the quote character, or a line break get quoted
+    QUOTE_ALL, // every field gets quoted
+    QUOTE_NONE // nothing gets quoted. Fields are written exactly as they are stored.
+};
+
+// writes a table of data back out to a delimited text file. The counterpart to TableReader.
+class TableWriter
+{
+    public:
+        TableWriter();
+        virtual ~TableWriter(); // flushes anything still in the buffer, and closes the file if it is still open. A failed flush is dropped; call close() to find out about it.
+        virtual void setDelim(const std::string& inDelim); // sets the string written between fields. Also sets autoDelim to false, so writeTable() will not replace it with the reader's delimiter.
+        virtual void setDelim(const char inDelim); // same as above, for a single character
+        virtual void unsetDelim(); // goes back to using the delimiter of whatever TableReader is written out, or a comma if there is none
+        virtual void setQuoteChar(const char inQuote); // sets the character used to quote fields. Defaults to double quotes.
+        virtual void setQuoteMode(QuoteMode inMode); // sets when fields get quoted. Defaults to QUOTE_MINIMAL.
+        virtual void setBufferSize(size_t inBytes); // sets how many bytes are collected before they are handed to the file. Defaults to 1 MB.
+        virtual void setNumThreads(int inThreads); // sets how many threads format rows in writeColumns(). Defaults to 1. Output order is the same no matter how many threads are used.
+        virtual void open(std::string fileName); // opens the output file, truncating it if it already exists. Throws FileOpenError if it can't be opened.
+        virtual void close(); // flushes the buffer and closes the file
+        virtual void writeTable(TableReader& reader); // writes every column held by the reader, in the reader's layout
+        virtual void writeColumns(const std::vector< std::vector<std::string> >& columns); // writes a set of columns laid out like TableReader::rawCols, so that columns[i][j] is column i, row j
+        virtual void writeRow(const std::vector<std::string>& fields); // writes one row of fields
+        // field-at-a-time interface. Call appendField() once for each field, then endRow().
+        virtual void appendField(const std::string& field);
+        virtual void appendField(int value);
+        virtual void appendField(long value);
+        virtual void appendField(long long value);
+        virtual void appendField(double value);
+        virtual void endRow();
+        virtual void flush(); // hands everything in the buffer to the file. Throws FileWriteError if the write fails.
+        // "get" methods:
+        virtual std::string getDelim(); // returns the delimiter being written between fields
+        virtual std::string getFilename(); // returns the name of the output file
+        virtual long getNumRowsWritten(); // returns the number of rows written since the file was opened
+    protected:
+        // helper functions:
+        virtual void formatRows(const std::vector< std::vector<std::string> >& columns, size_t firstRow, size_t lastRow, std::string& out); // formats rows [firstRow, lastRow) into out
+        virtual void appendEscaped(std::string& out, const char* field, size_t length); // appends one field to out, quoting it if the quote mode calls for it
+        virtual bool needsQuotes(const char* field, size_t length); // whether a field has to be quoted under QUOTE_MINIMAL
+        virtual void startField(); // puts a delimiter in front of every field but the first one in a row
+        virtual void flushIfFull(); // flushes once the buffer has grown past bufferSize
+        // data members
+        std::ofstream outFile; // the file stream object used to write out the data
+        std::string filename; // the name of the output file
+        bool autoDelim; // whether or not to take the delimiter from the TableReader being written. defaults to true
+        std::string delim; // the delimiter written between fields
+        char quoteChar; // the character used to quote fields
+        QuoteMode quoteMode; // when to quote fields
+        size_t bufferSize; // how large the buffer is allowed to grow before it is flushed
+        int numThreads; // how many threads to format rows with
+        std::string buffer; // formatted output waiting to be written. Cleared after every flush, but keeps its capacity.
+        std::vector<std::string> chunkBuffers; // one output buffer per formatting thread. Kept between calls so their capacity gets reused.
+        bool rowStarted; // whether a field has already been appended to the current row
+        long rowsWritten; // the number of rows written since the file was opened
+};
+
+#endif
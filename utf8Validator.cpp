@@ -0,0 +1,114 @@
+#include "tableReader.h"
+// implementation for the Utf8Validator class.
+using namespace std;
+
+// constructor
+Utf8Validator::Utf8Validator() : bytesNeeded(0), lowerBound(0x80), upperBound(0xBF), errorOffset(-1)
+{
+    // starts out between characters
+}
+
+// destructor. Only written to make sure it's virtual.
+Utf8Validator::~Utf8Validator()
+{
+    // nothing to do here
+}
+
+// Checks the next block of the stream, one byte at a time. TableReader only calls this for blocks that hold non-ASCII bytes,
+// or that start in the middle of a character, so it doesn't need to be fast on plain ASCII.
+// The bounds on each continuation byte rule out overlong encodings, surrogates, and code points past U+10FFFF.
+bool Utf8Validator::validate(const char* data, size_t length, long long streamOffset)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char b = bytes[i];
+        if (bytesNeeded == 0)
+        {
+            if (b < 0x80)
+            {
+                continue;
+            }
+            lowerBound = 0x80;
+            upperBound = 0xBF;
+            if (b >= 0xC2 && b <= 0xDF)
+            {
+                bytesNeeded = 1;
+            }
+            else if (b == 0xE0)
+            {
+                bytesNeeded = 2;
+                lowerBound = 0xA0; // anything lower would be an overlong encoding
+            }
+            else if ((b >= 0xE1 && b <= 0xEC) || b == 0xEE || b == 0xEF)
+            {
+                bytesNeeded = 2;
+            }
+            else if (b == 0xED)
+            {
+                bytesNeeded = 2;
+                upperBound = 0x9F; // anything higher would be a UTF-16 surrogate
+            }
+            else if (b == 0xF0)
+            {
+                bytesNeeded = 3;
+                lowerBound = 0x90;
+            }
+            else if (b >= 0xF1 && b <= 0xF3)
+            {
+                bytesNeeded = 3;
+            }
+            else if (b == 0xF4)
+            {
+                bytesNeeded = 3;
+                upperBound = 0x8F; // anything higher would be past U+10FFFF
+            }
+            else
+            {
+                errorOffset = streamOffset + i;
+                return false;
+            }
+        }
+        else
+        {
+            if (b < lowerBound || b > upperBound)
+            {
+                errorOffset = streamOffset + i;
+                return false;
+            }
+            bytesNeeded--;
+            lowerBound = 0x80;
+            upperBound = 0xBF;
+        }
+    }
+    return true;
+}
+
+// checks that the stream didn't end partway through a character
+bool Utf8Validator::finish(long long streamOffset)
+{
+    if (bytesNeeded != 0)
+    {
+        errorOffset = streamOffset;
+        return false;
+    }
+    return true;
+}
+
+bool Utf8Validator::inCharacter()
+{
+    return bytesNeeded != 0;
+}
+
+long long Utf8Validator::getErrorOffset()
+{
+    return errorOffset;
+}
+
+void Utf8Validator::reset()
+{
+    bytesNeeded = 0;
+    lowerBound = 0x80;
+    upperBound = 0xBF;
+    errorOffset = -1;
+}